@@ -3,31 +3,69 @@
 
 
 AABB::AABB(float _maxX, float _minX, float _maxY, float _minY)
-	: maxX(_maxX), minX(_minX), maxY(_maxY), minY(_minY), polyRef(nullptr)
+	: maxX(_maxX), minX(_minX), maxY(_maxY), minY(_minY)
 {
 }
 
-AABB* AABB::Merge(AABB* other)
+AABB AABB::Merge(const AABB& other) const
 {
-	const float _maxX = (other->maxX > maxX) ? other->maxX : maxX;
-	const float _maxY = (other->maxY > maxY) ? other->maxY : maxY;
-	const float _minX = (other->minX < minX) ? other->minX : minX;
-	const float _minY = (other->minY < minY) ? other->minY : minY;
+	const float _maxX = (other.maxX > maxX) ? other.maxX : maxX;
+	const float _maxY = (other.maxY > maxY) ? other.maxY : maxY;
+	const float _minX = (other.minX < minX) ? other.minX : minX;
+	const float _minY = (other.minY < minY) ? other.minY : minY;
 
-	AABB* newAABB = new AABB(_maxX, _minX, _maxY, _minY);
-	return newAABB;
+	return AABB(_maxX, _minX, _maxY, _minY);
 }
 
-bool AABB::Contain(AABB* other) const
+bool AABB::Contain(const AABB& other) const
 {
-	return (minX <= other->minX && maxX >= other->maxX)
-		&& (minY <= other->minY && maxY >= other->maxY);
+	return (minX <= other.minX && maxX >= other.maxX)
+		&& (minY <= other.minY && maxY >= other.maxY);
 }
 
-bool AABB::Collide(AABB* other) const
+bool AABB::Collide(const AABB& other) const
 {
-	return (maxX >= other->minX && minX <= other->maxX)
-		&& (maxY >= other->minY && minY <= other->maxY);
+	return (maxX >= other.minX && minX <= other.maxX)
+		&& (maxY >= other.minY && minY <= other.maxY);
+}
+
+bool AABB::ContainPoint(const Vec2& point) const
+{
+	return (point.x >= minX && point.x <= maxX)
+		&& (point.y >= minY && point.y <= maxY);
+}
+
+bool AABB::RayCast(const Vec2& from, const Vec2& delta, float maxFraction) const
+{
+	float enter = 0.0f;
+	float exit = maxFraction;
+
+	const float origins[2] = { from.x, from.y };
+	const float deltas[2] = { delta.x, delta.y };
+	const float mins[2] = { minX, minY };
+	const float maxs[2] = { maxX, maxY };
+
+	for (int axis = 0; axis < 2; ++axis)
+	{
+		if (deltas[axis] == 0.0f)
+		{
+			/** Parallel to the slab, only hits if already inside it **/
+			if (origins[axis] < mins[axis] || origins[axis] > maxs[axis])
+				return false;
+			continue;
+		}
+
+		const float invDelta = 1.0f / deltas[axis];
+		float slabEnter = (mins[axis] - origins[axis]) * invDelta;
+		float slabExit = (maxs[axis] - origins[axis]) * invDelta;
+		if (slabEnter > slabExit) std::swap(slabEnter, slabExit);
+
+		enter = Max(enter, slabEnter);
+		exit = Min(exit, slabExit);
+		if (enter > exit) return false;
+	}
+
+	return true;
 }
 
 float AABB::Volume() const
@@ -36,3 +74,27 @@ float AABB::Volume() const
 	const float height = maxY - minY;
 	return length * height;
 }
+float AABB::Perimeter() const
+{
+	return 2.0f * ((maxX - minX) + (maxY - minY));
+}
+
+AABB ComputePolygonAABB(const CPolygon& poly)
+{
+	AABB polyAABB;
+
+	for (const Vec2& transformatedPoint : poly.GetWorldPoints())
+	{
+		if (polyAABB.maxX < transformatedPoint.x) polyAABB.maxX = transformatedPoint.x;
+		if (polyAABB.minX > transformatedPoint.x) polyAABB.minX = transformatedPoint.x;
+		if (polyAABB.maxY < transformatedPoint.y) polyAABB.maxY = transformatedPoint.y;
+		if (polyAABB.minY > transformatedPoint.y) polyAABB.minY = transformatedPoint.y;
+	}
+
+	/** One or two core points for circles and capsules **/
+	polyAABB.maxX += poly.radius;
+	polyAABB.minX -= poly.radius;
+	polyAABB.maxY += poly.radius;
+	polyAABB.minY -= poly.radius;
+	return polyAABB;
+}
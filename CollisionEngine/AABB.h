@@ -5,17 +5,21 @@
 
 struct AABB
 {
-	AABB(float _maxX = FLT_MIN, float _minX = FLT_MAX, float _maxY = FLT_MIN, float _minY = FLT_MAX);
-	AABB* Merge(AABB* other);
-	bool Contain(AABB* other) const;
-	bool Collide(AABB* other) const;
+	AABB(float _maxX = -FLT_MAX, float _minX = FLT_MAX, float _maxY = -FLT_MAX, float _minY = FLT_MAX);
+	AABB Merge(const AABB& other) const;
+	bool Contain(const AABB& other) const;
+	bool Collide(const AABB& other) const;
+	bool ContainPoint(const Vec2& point) const;
+	/** Slab test of the segment from + delta * [0, maxFraction] **/
+	bool RayCast(const Vec2& from, const Vec2& delta, float maxFraction) const;
 	float Volume() const;
+	float Perimeter() const;
 
 	float maxX;
 	float minX;
 	float maxY;
 	float minY;
-
-	CPolygonPtr polyRef;
 };
 
+/** Tight world space bounds of a polygon at its current transform **/
+AABB ComputePolygonAABB(const CPolygon& poly);
@@ -2,48 +2,32 @@
 
 AABBTreeNode::AABBTreeNode()
 {
-	parent = nullptr;
-	children[0] = children[1] = nullptr;
-	polyAABB = nullptr;
-	fatAABB = new AABB;
+	Reset();
 }
 
-AABBTreeNode::~AABBTreeNode()
+bool AABBTreeNode::IsLeaf() const
 {
-	parent = nullptr;
-
-	if (children[0])
-		delete children[0];
-	if (children[1])
-		delete children[1];
-
-	children[0] = children[1] = nullptr;
-	delete polyAABB;
-	delete fatAABB;
+	return children[0] == AABB_NULL_NODE;
 }
 
-bool AABBTreeNode::IsLeaf()
+void AABBTreeNode::SetAsBranch(int32_t child1, int32_t child2)
 {
-	return !children[0] && !children[1];
-}
-
-void AABBTreeNode::SetAsBranch(AABBTreeNode* child1, AABBTreeNode* child2)
-{
-	child1->parent = this;
-	child2->parent = this;
-
 	children[0] = child1;
 	children[1] = child2;
+	polyRef.reset();
 }
 
-void AABBTreeNode::SetAsLeaf(AABB* userBox)
+void AABBTreeNode::SetAsLeaf(const CPolygonPtr& poly)
 {
-	polyAABB = userBox;
-	children[0] = children[1] = nullptr;
+	polyRef = poly;
+	children[0] = children[1] = AABB_NULL_NODE;
 }
 
-
-AABBTreeNode* AABBTreeNode::GetSibling() const
+void AABBTreeNode::Reset()
 {
-	return this == parent->children[0] ? parent->children[1] : parent->children[0];
+	parent = AABB_NULL_NODE;
+	children[0] = children[1] = AABB_NULL_NODE;
+	polyRef.reset();
+	height = 0;
+	isStatic = false;
 }
@@ -1,19 +1,27 @@
 #pragma once
+#include <cstdint>
 #include "AABB.h"
 
-typedef struct  AABBTreeNode
+/** Nodes live in a contiguous pool owned by the tree, links are indices into that pool **/
+#define AABB_NULL_NODE (-1)
+
+struct AABBTreeNode
 {
 	AABBTreeNode();
-	~AABBTreeNode();
 
-	AABBTreeNode* parent;
-	AABBTreeNode* children[2];
-	AABB* fatAABB;
-	AABB* polyAABB;
-	bool crossed = false;;
+	AABB fatAABB;
+	AABB polyAABB;
+	CPolygonPtr polyRef;
+
+	/** parent is reused as the next free node link while the node sits in the free list **/
+	int32_t parent;
+	int32_t children[2];
+	/** Leaves have height 0, used to keep the tree AVL balanced **/
+	int32_t height;
+	bool isStatic;
 
-	bool IsLeaf();
-	void SetAsBranch(AABBTreeNode* child1, AABBTreeNode* child2);
-	void SetAsLeaf(AABB* userBox);
-	AABBTreeNode* GetSibling() const;
-} AABBTreeNode;
+	bool IsLeaf() const;
+	void SetAsBranch(int32_t child1, int32_t child2);
+	void SetAsLeaf(const CPolygonPtr& poly);
+	void Reset();
+};
@@ -7,6 +7,7 @@
 #include "Renderer.h"
 #include "SceneManager.h"
 #include "World.h"
+#include "ThreadPool.h"
 
 void InitApplication(int width, int height, float worldHeight)
 {
@@ -16,6 +17,7 @@ void InitApplication(int width, int height, float worldHeight)
 	gVars->pRenderer = new CRenderer(worldHeight);
 	gVars->pSceneManager = new CSceneManager();
 	gVars->pPhysicEngine = new CPhysicEngine();
+	gVars->pThreadPool = new CThreadPool();
 
 	gVars->bDebug = false;
 }
@@ -108,7 +108,7 @@ private:
 	
 
 
-		CPolygonPtr poly = gVars->pWorld->AddSymetricPolygon(radius, 3); // 5);
+		CPolygonPtr poly = gVars->pWorld->AddCircle(radius);
 		poly->density = 0.0f;
 		poly->position = pos;
 		poly->speed = circle.speed;
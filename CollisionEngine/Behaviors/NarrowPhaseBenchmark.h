@@ -0,0 +1,80 @@
+#ifndef _NARROW_PHASE_BENCHMARK_H_
+#define _NARROW_PHASE_BENCHMARK_H_
+
+#include "Behavior.h"
+#include "PhysicEngine.h"
+#include "GlobalVariables.h"
+#include "Renderer.h"
+#include "World.h"
+#include "AABB.h"
+#include "SatBatch.h"
+#include "Timer.h"
+
+#include <string>
+
+/** Times the scalar SAT against the SoA batch kernel on the same triangle / quad pairs every frame **/
+class CNarrowPhaseBenchmark : public CBehavior
+{
+private:
+	virtual void Update(float frameTime) override
+	{
+		GatherPairs();
+		if (m_pairs.empty())
+			return;
+
+		CTimer timer;
+		size_t scalarCollisions = 0;
+
+		timer.Start();
+		for (size_t repeat = 0; repeat < m_repeatCount; ++repeat)
+		{
+			scalarCollisions = 0;
+			for (const SPolygonPair& pair : m_pairs)
+			{
+				SCollision collision;
+				if (pair.polyA->CheckCollision(*pair.polyB, collision))
+					++scalarCollisions;
+			}
+		}
+		timer.Stop();
+		const float scalarDuration = timer.GetDuration();
+
+		timer.Start();
+		for (size_t repeat = 0; repeat < m_repeatCount; ++repeat)
+		{
+			m_collisions.clear();
+			SatBatchCollide(m_pairs.data(), m_pairs.size(), m_collisions);
+		}
+		timer.Stop();
+		const float batchDuration = timer.GetDuration();
+
+		const float pairCount = (float)(m_pairs.size() * m_repeatCount);
+		gVars->pRenderer->DisplayText("Narrowphase benchmark, " + std::to_string(m_pairs.size()) + " pairs, " + std::to_string(scalarCollisions) + " / " + std::to_string(m_collisions.size()) + " collisions");
+		gVars->pRenderer->DisplayText("Scalar SAT : " + std::to_string(pairCount / scalarDuration / 1e6f) + " M pairs/s");
+		gVars->pRenderer->DisplayText(std::string(IsSatBatchSimd() ? "SSE" : "Scalar") + " batch SAT : " + std::to_string(pairCount / batchDuration / 1e6f) + " M pairs/s");
+	}
+
+	/** Every triangle / quad against the candidates overlapping its box **/
+	void GatherPairs()
+	{
+		m_pairs.clear();
+		gVars->pWorld->ForEachPolygon([&](CPolygonPtr polyA)
+		{
+			if (!IsSatBatchCandidate(*polyA))
+				return;
+
+			gVars->pPhysicEngine->QueryAABB(ComputePolygonAABB(*polyA), [&](const CPolygonPtr& polyB)
+			{
+				if (polyA->GetIndex() < polyB->GetIndex() && IsSatBatchCandidate(*polyB))
+					m_pairs.push_back(SPolygonPair(polyA, polyB));
+				return true;
+			});
+		});
+	}
+
+	std::vector<SPolygonPair>	m_pairs;
+	std::vector<SCollision>		m_collisions;
+	const size_t				m_repeatCount = 10;
+};
+
+#endif
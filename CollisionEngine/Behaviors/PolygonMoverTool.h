@@ -12,19 +12,9 @@ class CPolygonMoverTool : public CBehavior
 {
 	CPolygonPtr	GetClickedPolygon()
 	{
-		Vec2 pt, n;
 		Vec2 mousePoint = gVars->pRenderer->ScreenToWorldPos(gVars->pRenderWindow->GetMousePos());
-		CPolygonPtr clickedPoly;
 
-		gVars->pWorld->ForEachPolygon([&](CPolygonPtr poly)
-		{
-			if (poly->IsPointInside(mousePoint))
-			{
-				clickedPoly = poly;
-			}
-		});
-
-		return clickedPoly;
+		return gVars->pPhysicEngine->QueryPoint(mousePoint);
 	}
 
 	virtual void Update(float frameTime) override
@@ -39,7 +29,10 @@ class CPolygonMoverTool : public CBehavior
 				m_clickMousePos = m_prevMousePos;
 
 				if (m_selectedPoly)
+				{
 					m_clickAngle = m_selectedPoly->rotation.GetAngle();
+					m_selectedPoly->SetAwake(true);
+				}
 			}
 			else
 			{
@@ -63,6 +56,10 @@ class CPolygonMoverTool : public CBehavior
 					m_selectedPoly->speed = Vec2();
 				}
 
+				/** Held bodies don't move on their own, keep them out of sleep and draw them right under the mouse **/
+				m_selectedPoly->SetAwake(true);
+				m_selectedPoly->SavePreviousTransform();
+
 				m_prevMousePos = mousePoint;
 			}
 		}
@@ -136,7 +136,7 @@ private:
 
 	CPolygonPtr AddCircle(const Vec2& pos, float radius = RADIUS)
 	{
-		CPolygonPtr circle = gVars->pWorld->AddSymetricPolygon(radius, 50);
+		CPolygonPtr circle = gVars->pWorld->AddCircle(radius);
 		circle->density = 0.0f;
 		circle->position = pos;
 		m_circles.push_back(circle);
@@ -0,0 +1,34 @@
+#include "BroadPhase.h"
+#include "GlobalVariables.h"
+#include "World.h"
+
+void IBroadPhase::QueryAABB(const AABB& aabb, const TQueryCallback& callback)
+{
+	for (size_t index = 0; index < gVars->pWorld->GetPolygonCount(); ++index)
+	{
+		CPolygonPtr poly = gVars->pWorld->GetPolygon(index);
+		if (ComputePolygonAABB(*poly).Collide(aabb) && !callback(poly))
+			return;
+	}
+}
+
+void IBroadPhase::QueryPoint(const Vec2& point, const TQueryCallback& callback)
+{
+	QueryAABB(AABB(point.x, point.x, point.y, point.y), callback);
+}
+
+void IBroadPhase::RayCast(const SRayCastInput& input, const TRayCastCallback& callback)
+{
+	SRayCastInput clippedInput = input;
+	const Vec2 delta = input.to - input.from;
+
+	for (size_t index = 0; index < gVars->pWorld->GetPolygonCount(); ++index)
+	{
+		CPolygonPtr poly = gVars->pWorld->GetPolygon(index);
+		if (!ComputePolygonAABB(*poly).RayCast(input.from, delta, clippedInput.maxFraction)) continue;
+
+		const float fraction = callback(clippedInput, poly);
+		if (fraction == 0.0f) return;
+		clippedInput.maxFraction = Min(clippedInput.maxFraction, fraction);
+	}
+}
@@ -1,7 +1,15 @@
 #ifndef _BROAD_PHASE_H_
 #define _BROAD_PHASE_H_
 
+#include <functional>
 #include "PhysicEngine.h"
+#include "AABB.h"
+
+/** Called for every body whose AABB overlaps the query, return false to stop the query **/
+typedef std::function<bool(const CPolygonPtr& poly)>	TQueryCallback;
+/** Called for every body whose AABB is crossed by the ray, returns the new max fraction :
+0 stops, input.maxFraction goes on, the hit fraction clips the ray to keep only closer bodies **/
+typedef std::function<float(const SRayCastInput& input, const CPolygonPtr& poly)>	TRayCastCallback;
 
 class IBroadPhase
 {
@@ -10,6 +18,11 @@ public:
 	virtual void GetCollidingPairsToCheck(std::vector<SPolygonPair>& pairsToCheck) = 0;
 	virtual void Init() = 0;
 	virtual void DrawGizmos() = 0;
+
+	// Spatial queries on the tight AABBs, default ones test every body of the world
+	virtual void QueryAABB(const AABB& aabb, const TQueryCallback& callback);
+	virtual void QueryPoint(const Vec2& point, const TQueryCallback& callback);
+	virtual void RayCast(const SRayCastInput& input, const TRayCastCallback& callback);
 };
 
-#endif
\ No newline at end of file
+#endif
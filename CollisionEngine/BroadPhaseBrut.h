@@ -10,6 +10,9 @@
 class CBroadPhaseBrut : public IBroadPhase
 {
 public:
+	virtual void Init() override {}
+	virtual void DrawGizmos() override {}
+
 	virtual void GetCollidingPairsToCheck(std::vector<SPolygonPair>& pairsToCheck) override
 	{
 		for (size_t i = 0; i < gVars->pWorld->GetPolygonCount(); ++i)
@@ -2,7 +2,10 @@
 #include "GlobalVariables.h"
 #include "World.h"
 #include "Renderer.h"
+#include "PhysicEngine.h"
+#include "ThreadPool.h"
 #include <string>
+#include <algorithm>
 
 CBroadPhaseAABBTree::CBroadPhaseAABBTree()
 {
@@ -11,345 +14,1030 @@ CBroadPhaseAABBTree::CBroadPhaseAABBTree()
 
 CBroadPhaseAABBTree::~CBroadPhaseAABBTree()
 {
-	delete m_root;
-	m_root = nullptr;
+	m_nodes.clear();
+	m_leaves.clear();
+	m_staticProxies.clear();
+	m_moveBuffer.clear();
+	m_persistentPairs.clear();
+	m_root = m_staticRoot = m_freeList = AABB_NULL_NODE;
 }
 
 void CBroadPhaseAABBTree::Init()
 {
 	const size_t polyCount = gVars->pWorld->GetPolygonCount();
+
+	/** A binary tree over n leaves holds 2n - 1 nodes, reserve them once so the pool never grows while running **/
+	m_nodes.reserve(2 * polyCount);
+	m_leaves.reserve(polyCount);
+	m_invalidNodes.reserve(polyCount);
+
 	for (size_t index = 0; index < polyCount; ++index)
 	{
-		const CPolygonPtr poly = gVars->pWorld->GetPolygon(index);
-		Add(BuildPolyAABB(poly));
+		CreateLeaf(gVars->pWorld->GetPolygon(index));
 	}
+
+	/** Bulk build instead of one insertion per polygon **/
+	m_buildLeaves.clear();
+	for (const SStaticProxy& proxy : m_staticProxies)
+		m_buildLeaves.push_back(proxy.leaf);
+	m_staticRoot = BuildTree(m_buildLeaves, m_staticRoot);
+
+	Rebuild();
 }
 
 void CBroadPhaseAABBTree::GetCollidingPairsToCheck(std::vector<SPolygonPair>& pairsToCheck)
 {
 	m_nodePairs.clear();
 
-	if (!m_root) Init();
-
-	if (m_root->IsLeaf()) return;
+	if (m_leaves.empty() && m_staticProxies.empty()) Init();
 
-	ClearCrossFlag(m_root);
+	if (m_root == AABB_NULL_NODE) return;
 
 	Update();
 
-	ComputePairs(m_root->children[0], m_root->children[1]);
+	if (m_incrementalPairs)
+	{
+		QueryMovedProxies();
+		UpdatePersistentPairs();
+	}
+	else
+	{
+		m_moveBuffer.clear();
 
-	const std::string str = "Potential Pairs : " + std::to_string(m_nodePairs.size());
-	gVars->pRenderer->DisplayText(str, 50, 150);
+		if (UseThreadPool())
+			ComputeAllPairsParallel();
+		else
+			ComputeAllPairs();
+	}
+
+	if (gVars->bDebug && gVars->pPhysicEngine->IsDebugStep())
+	{
+		const std::string str = "Potential Pairs : " + std::to_string(m_nodePairs.size());
+		gVars->pRenderer->DisplayText(str, 50, 150);
+
+		const std::string treeStr = "Tree height : " + std::to_string(GetTreeHeight()) + ", SAH cost : " + std::to_string(GetTreeSAHCost());
+		gVars->pRenderer->DisplayText(treeStr, 50, 250);
+	}
 
 	pairsToCheck = m_nodePairs;
 }
 
-void CBroadPhaseAABBTree::InsertNode(AABBTreeNode* node, AABBTreeNode** parent) const
+void CBroadPhaseAABBTree::QueryAABB(const AABB& aabb, const TQueryCallback& callback)
+{
+	if (m_leaves.empty() && m_staticProxies.empty()) Init();
+
+	if (QueryTree(m_root, aabb, callback))
+		QueryTree(m_staticRoot, aabb, callback);
+}
+
+void CBroadPhaseAABBTree::RayCast(const SRayCastInput& input, const TRayCastCallback& callback)
+{
+	if (m_leaves.empty() && m_staticProxies.empty()) Init();
+
+	/** Fraction clipped in the dynamic tree carries over to the static one **/
+	SRayCastInput clippedInput = input;
+	if (RayCastTree(m_root, clippedInput, callback))
+		RayCastTree(m_staticRoot, clippedInput, callback);
+}
+
+bool CBroadPhaseAABBTree::QueryTree(int32_t root, const AABB& aabb, const TQueryCallback& callback)
 {
-	AABBTreeNode* refParent = *parent;
-	if (refParent->IsLeaf())
+	if (root == AABB_NULL_NODE) return true;
+
+	m_queryStack.clear();
+	m_queryStack.push_back(root);
+
+	while (!m_queryStack.empty())
 	{
-		AABBTreeNode* newParent = new AABBTreeNode;
-		newParent->parent = refParent->parent;
-		newParent->SetAsBranch(node, refParent);
-		*parent = newParent;
+		const int32_t node = m_queryStack.back();
+		m_queryStack.pop_back();
+
+		const AABBTreeNode& treeNode = m_nodes[node];
+
+		if (treeNode.IsLeaf())
+		{
+			if (treeNode.fatAABB.Collide(aabb) && !callback(treeNode.polyRef))
+				return false;
+		}
+		else if (treeNode.fatAABB.Collide(aabb))
+		{
+			m_queryStack.push_back(treeNode.children[0]);
+			m_queryStack.push_back(treeNode.children[1]);
+		}
 	}
-	else
+
+	return true;
+}
+
+bool CBroadPhaseAABBTree::RayCastTree(int32_t root, SRayCastInput& input, const TRayCastCallback& callback)
+{
+	if (root == AABB_NULL_NODE) return true;
+
+	const Vec2 delta = input.to - input.from;
+
+	m_queryStack.clear();
+	m_queryStack.push_back(root);
+
+	while (!m_queryStack.empty())
 	{
-		AABB* aabb0 = refParent->children[0]->fatAABB;
-		AABB* aabb1 = refParent->children[1]->fatAABB;
+		const int32_t node = m_queryStack.back();
+		m_queryStack.pop_back();
 
-		const float volumeMin0 = aabb0->Merge(node->fatAABB)->Volume() - aabb0->Volume();
-		const float volumeMin1 = aabb1->Merge(node->fatAABB)->Volume() - aabb1->Volume();
+		const AABBTreeNode& treeNode = m_nodes[node];
 
-		if (volumeMin0 < volumeMin1)
-			InsertNode(node, &refParent->children[0]);
-		else
-			InsertNode(node, &refParent->children[1]);
+		if (treeNode.IsLeaf())
+		{
+			if (!treeNode.fatAABB.RayCast(input.from, delta, input.maxFraction)) continue;
+
+			const float fraction = callback(input, treeNode.polyRef);
+			if (fraction == 0.0f) return false;
+			input.maxFraction = Min(input.maxFraction, fraction);
+		}
+		else if (treeNode.fatAABB.RayCast(input.from, delta, input.maxFraction))
+		{
+			m_queryStack.push_back(treeNode.children[0]);
+			m_queryStack.push_back(treeNode.children[1]);
+		}
 	}
-	UpdateFatAABB(*parent);
+
+	return true;
+}
+
+void CBroadPhaseAABBTree::SetIncrementalPairs(bool incremental)
+{
+	if (incremental == m_incrementalPairs) return;
+	m_incrementalPairs = incremental;
+
+	/** The persistent set is only valid if every move went through the move buffer, so start again from every proxy **/
+	m_persistentPairs.clear();
+	m_moveBuffer = m_leaves;
+	for (const SStaticProxy& proxy : m_staticProxies)
+		m_moveBuffer.push_back(proxy.leaf);
+}
+
+float CBroadPhaseAABBTree::GetReinsertRate() const
+{
+	return m_reinsertRate;
 }
 
-void CBroadPhaseAABBTree::Add(AABB* trueAABB)
+float CBroadPhaseAABBTree::GetAverageReinsertRate() const
 {
-	if (m_root)
+	return m_averageReinsertRate;
+}
+
+int32_t CBroadPhaseAABBTree::AllocateNode()
+{
+	if (m_freeList == AABB_NULL_NODE)
 	{
-		AABBTreeNode* newNode = new AABBTreeNode;
-		newNode->SetAsLeaf(trueAABB);
-		UpdateFatAABB(newNode);
-		InsertNode(newNode, &m_root);
+		m_nodes.emplace_back();
+		return (int32_t)m_nodes.size() - 1;
 	}
+
+	const int32_t node = m_freeList;
+	m_freeList = m_nodes[node].parent;
+	m_nodes[node].Reset();
+	return node;
+}
+
+void CBroadPhaseAABBTree::FreeNode(int32_t node)
+{
+	m_nodes[node].Reset();
+	m_nodes[node].parent = m_freeList;
+	m_freeList = node;
+}
+
+void CBroadPhaseAABBTree::InsertNode(int32_t node, int32_t& root)
+{
+	if (root == AABB_NULL_NODE)
+	{
+		root = node;
+		m_nodes[node].parent = AABB_NULL_NODE;
+		return;
+	}
+
+	/** Descend toward the child whose fat box grows the least **/
+	const AABB& nodeAABB = m_nodes[node].fatAABB;
+	int32_t sibling = root;
+	while (!m_nodes[sibling].IsLeaf())
+	{
+		const AABB& aabb0 = m_nodes[m_nodes[sibling].children[0]].fatAABB;
+		const AABB& aabb1 = m_nodes[m_nodes[sibling].children[1]].fatAABB;
+
+		const float volumeMin0 = aabb0.Merge(nodeAABB).Volume() - aabb0.Volume();
+		const float volumeMin1 = aabb1.Merge(nodeAABB).Volume() - aabb1.Volume();
+
+		sibling = (volumeMin0 < volumeMin1) ? m_nodes[sibling].children[0] : m_nodes[sibling].children[1];
+	}
+
+	/** AllocateNode may grow the pool, so only hold indices across it **/
+	const int32_t oldParent = m_nodes[sibling].parent;
+	const int32_t newParent = AllocateNode();
+
+	m_nodes[newParent].parent = oldParent;
+	m_nodes[newParent].SetAsBranch(node, sibling);
+	m_nodes[node].parent = newParent;
+	m_nodes[sibling].parent = newParent;
+
+	if (oldParent == AABB_NULL_NODE)
+	{
+		root = newParent;
+	}
+	else
+	{
+		AABBTreeNode& parent = m_nodes[oldParent];
+		parent.children[parent.children[0] == sibling ? 0 : 1] = newParent;
+	}
+
+	RefitFrom(newParent, root);
+}
+
+int32_t CBroadPhaseAABBTree::Add(const CPolygonPtr& poly)
+{
+	const int32_t leaf = CreateLeaf(poly);
+	InsertNode(leaf, m_nodes[leaf].isStatic ? m_staticRoot : m_root);
+	return leaf;
+}
+
+int32_t CBroadPhaseAABBTree::CreateLeaf(const CPolygonPtr& poly)
+{
+	const int32_t leaf = AllocateNode();
+	AABBTreeNode& node = m_nodes[leaf];
+	node.SetAsLeaf(poly);
+	node.polyAABB = BuildPolyAABB(poly);
+	node.isStatic = (poly->density == 0.0f);
+	UpdateFatAABB(node);
+
+	m_moveBuffer.push_back(leaf);
+
+	if (node.isStatic)
+		m_staticProxies.push_back({ leaf, poly->position, poly->rotation });
 	else
+		m_leaves.push_back(leaf);
+
+	return leaf;
+}
+
+void CBroadPhaseAABBTree::Rebuild()
+{
+	m_buildLeaves = m_leaves;
+	m_root = BuildTree(m_buildLeaves, m_root);
+	m_lastBuildCost = GetTreeSAHCost();
+	m_framesSinceQualityCheck = 0;
+}
+
+void CBroadPhaseAABBTree::SetRebuildThreshold(float ratio)
+{
+	m_rebuildThreshold = ratio;
+}
+
+int32_t CBroadPhaseAABBTree::BuildTree(std::vector<int32_t>& leaves, int32_t root)
+{
+	/** Recycle the branch nodes of the previous tree, leaves are kept as they are so pairs stay valid **/
+	m_buildNodes.clear();
+	if (root != AABB_NULL_NODE)
+		m_buildNodes.push_back(root);
+
+	for (size_t index = 0; index < m_buildNodes.size(); ++index)
+	{
+		const AABBTreeNode& treeNode = m_nodes[m_buildNodes[index]];
+		if (treeNode.IsLeaf()) continue;
+		m_buildNodes.push_back(treeNode.children[0]);
+		m_buildNodes.push_back(treeNode.children[1]);
+	}
+
+	for (int32_t node : m_buildNodes)
 	{
-		m_root = new AABBTreeNode;
-		m_root->SetAsLeaf(trueAABB);
-		UpdateFatAABB(m_root);
+		if (!m_nodes[node].IsLeaf())
+			FreeNode(node);
 	}
+
+	if (leaves.empty()) return AABB_NULL_NODE;
+
+	/** n leaves need n - 1 branches, allocate them all upfront so the build never touches the pool **/
+	m_buildNodes.clear();
+	for (size_t index = 0; index + 1 < leaves.size(); ++index)
+		m_buildNodes.push_back(AllocateNode());
+
+	const bool parallel = gVars->pThreadPool && gVars->pThreadPool->GetThreadCount() > 1 && (int32_t)leaves.size() >= m_parallelBuildThreshold;
+	const int32_t newRoot = parallel ? BuildSubtreeParallel(leaves.data(), (int32_t)leaves.size(), m_buildNodes.data())
+									 : BuildSubtree(leaves.data(), (int32_t)leaves.size(), m_buildNodes.data());
+	m_nodes[newRoot].parent = AABB_NULL_NODE;
+	return newRoot;
 }
 
-void CBroadPhaseAABBTree::Remove(AABBTreeNode* deleteMe)
+int32_t CBroadPhaseAABBTree::SplitLeaves(int32_t* leaves, int32_t count) const
 {
-	AABBTreeNode* parent = deleteMe->parent;
+	/** Bin the leaf centroids along the widest centroid axis **/
+	AABB centroidBounds;
+	for (int32_t index = 0; index < count; ++index)
+	{
+		const AABB& aabb = m_nodes[leaves[index]].fatAABB;
+		const Vec2 centroid((aabb.minX + aabb.maxX) * 0.5f, (aabb.minY + aabb.maxY) * 0.5f);
+		centroidBounds = centroidBounds.Merge(AABB(centroid.x, centroid.x, centroid.y, centroid.y));
+	}
+
+	const bool splitX = (centroidBounds.maxX - centroidBounds.minX) >= (centroidBounds.maxY - centroidBounds.minY);
+	const float axisMin = splitX ? centroidBounds.minX : centroidBounds.minY;
+	const float axisExtent = splitX ? centroidBounds.maxX - centroidBounds.minX : centroidBounds.maxY - centroidBounds.minY;
+
+	auto getBin = [&](int32_t leaf)
+	{
+		const AABB& aabb = m_nodes[leaf].fatAABB;
+		const float centroid = splitX ? (aabb.minX + aabb.maxX) * 0.5f : (aabb.minY + aabb.maxY) * 0.5f;
+		return Min((int32_t)((centroid - axisMin) * (s_binCount / axisExtent)), s_binCount - 1);
+	};
+
+	int32_t leftCount = count / 2;
 
-	if (parent)
+	if (axisExtent > 0.0f)
 	{
-		AABBTreeNode* sibling = deleteMe->GetSibling();
-		if (parent->parent)
+		AABB binBounds[s_binCount];
+		int32_t binCounts[s_binCount] = {};
+
+		for (int32_t index = 0; index < count; ++index)
 		{
-			sibling->parent = parent->parent;
-			if (parent == parent->parent->children[0])
-				parent->parent->children[0] = sibling;
-			else
-				parent->parent->children[1] = sibling;
+			const int32_t bin = getBin(leaves[index]);
+			binBounds[bin] = binBounds[bin].Merge(m_nodes[leaves[index]].fatAABB);
+			++binCounts[bin];
 		}
-		else
+
+		/** Sweep from the right to get the cost of every right side, then from the left to evaluate each split plane **/
+		float rightCosts[s_binCount];
+		AABB rightBounds;
+		int32_t rightCount = 0;
+		for (int32_t bin = s_binCount - 1; bin > 0; --bin)
 		{
-			m_root = sibling;
-			m_root->parent = nullptr;
+			rightBounds = rightBounds.Merge(binBounds[bin]);
+			rightCount += binCounts[bin];
+			rightCosts[bin] = rightCount ? rightBounds.Perimeter() * rightCount : 0.0f;
+		}
+
+		float bestCost = FLT_MAX;
+		int32_t bestSplit = 0;
+		AABB leftBounds;
+		int32_t leftBinCount = 0;
+		for (int32_t split = 1; split < s_binCount; ++split)
+		{
+			leftBounds = leftBounds.Merge(binBounds[split - 1]);
+			leftBinCount += binCounts[split - 1];
+			if (leftBinCount == 0 || leftBinCount == count) continue;
+
+			const float cost = leftBounds.Perimeter() * leftBinCount + rightCosts[split];
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				bestSplit = split;
+			}
+		}
+
+		if (bestSplit > 0)
+		{
+			leftCount = (int32_t)(std::partition(leaves, leaves + count, [&](int32_t leaf) { return getBin(leaf) < bestSplit; }) - leaves);
 		}
-		delete deleteMe;
-		delete parent;
+	}
+
+	return leftCount;
+}
+
+int32_t CBroadPhaseAABBTree::BuildSubtree(int32_t* leaves, int32_t count, const int32_t* internalNodes)
+{
+	if (count == 1) return leaves[0];
+
+	/** Left subtree uses the next leftCount - 1 branches, right subtree the ones after **/
+	const int32_t leftCount = SplitLeaves(leaves, count);
+	const int32_t node = internalNodes[0];
+
+	const int32_t leftChild = BuildSubtree(leaves, leftCount, internalNodes + 1);
+	const int32_t rightChild = BuildSubtree(leaves + leftCount, count - leftCount, internalNodes + leftCount);
+	LinkBranch(node, leftChild, rightChild);
+
+	return node;
+}
+
+int32_t CBroadPhaseAABBTree::BuildSubtreeParallel(int32_t* leaves, int32_t count, const int32_t* internalNodes)
+{
+	/** The top levels are split here, down to m_buildTaskDepth, and the subtrees below are built on the thread pool.
+	A subtree root is known before it is built (its only leaf, or its first branch), so the top branches are linked afterwards, children first **/
+	m_buildTasks.clear();
+	m_buildBranches.clear();
+	SplitBuildTasks(leaves, count, internalNodes, 0);
+
+	gVars->pThreadPool->ParallelFor(m_buildTasks.size(), [this](size_t taskIndex)
+	{
+		const SBuildTask& task = m_buildTasks[taskIndex];
+		BuildSubtree(task.leaves, task.count, task.internalNodes);
+	});
+
+	for (auto branch = m_buildBranches.rbegin(); branch != m_buildBranches.rend(); ++branch)
+	{
+		LinkBranch(branch->node, branch->children[0], branch->children[1]);
+	}
+
+	return (count == 1) ? leaves[0] : internalNodes[0];
+}
+
+void CBroadPhaseAABBTree::SplitBuildTasks(int32_t* leaves, int32_t count, const int32_t* internalNodes, int32_t depth)
+{
+	if (count < m_parallelBuildThreshold || depth >= m_buildTaskDepth)
+	{
+		m_buildTasks.push_back({ leaves, count, internalNodes });
+		return;
+	}
+
+	const int32_t leftCount = SplitLeaves(leaves, count);
+	const int32_t rightCount = count - leftCount;
+
+	SBuildBranch branch;
+	branch.node = internalNodes[0];
+	branch.children[0] = (leftCount == 1) ? leaves[0] : internalNodes[1];
+	branch.children[1] = (rightCount == 1) ? leaves[leftCount] : internalNodes[leftCount];
+	m_buildBranches.push_back(branch);
+
+	SplitBuildTasks(leaves, leftCount, internalNodes + 1, depth + 1);
+	SplitBuildTasks(leaves + leftCount, rightCount, internalNodes + leftCount, depth + 1);
+}
+
+void CBroadPhaseAABBTree::LinkBranch(int32_t node, int32_t leftChild, int32_t rightChild)
+{
+	AABBTreeNode& treeNode = m_nodes[node];
+	treeNode.SetAsBranch(leftChild, rightChild);
+	treeNode.height = 1 + Max(m_nodes[leftChild].height, m_nodes[rightChild].height);
+	treeNode.fatAABB = m_nodes[leftChild].fatAABB.Merge(m_nodes[rightChild].fatAABB);
+	m_nodes[leftChild].parent = node;
+	m_nodes[rightChild].parent = node;
+}
+
+void CBroadPhaseAABBTree::CheckTreeQuality()
+{
+	if (m_rebuildThreshold <= 0.0f || ++m_framesSinceQualityCheck < m_qualityCheckInterval) return;
+	m_framesSinceQualityCheck = 0;
+
+	if (GetTreeSAHCost() > m_lastBuildCost * m_rebuildThreshold)
+		Rebuild();
+}
+
+void CBroadPhaseAABBTree::Remove(int32_t deleteMe)
+{
+	RemoveProxyPairs(deleteMe);
+
+	if (m_nodes[deleteMe].isStatic)
+	{
+		DetachNode(deleteMe, m_staticRoot);
+		m_staticProxies.erase(std::find_if(m_staticProxies.begin(), m_staticProxies.end(), [deleteMe](const SStaticProxy& proxy) { return proxy.leaf == deleteMe; }));
 	}
 	else
 	{
-		delete deleteMe;
-		m_root = nullptr;
+		DetachNode(deleteMe, m_root);
+
+		const std::vector<int32_t>::iterator it = std::find(m_leaves.begin(), m_leaves.end(), deleteMe);
+		if (it != m_leaves.end())
+		{
+			*it = m_leaves.back();
+			m_leaves.pop_back();
+		}
 	}
+
+	FreeNode(deleteMe);
 }
 
-void CBroadPhaseAABBTree::Update()
+void CBroadPhaseAABBTree::DetachNode(int32_t node, int32_t& root)
 {
-	if (!m_root) return;
+	if (node == root)
+	{
+		root = AABB_NULL_NODE;
+		return;
+	}
 
-	UpdatePolyAABB(m_root);
+	const int32_t parent = m_nodes[node].parent;
+	const int32_t grandParent = m_nodes[parent].parent;
+	const int32_t sibling = (m_nodes[parent].children[0] == node) ? m_nodes[parent].children[1] : m_nodes[parent].children[0];
 
-	if (!m_root->IsLeaf())
+	m_nodes[sibling].parent = grandParent;
+	if (grandParent == AABB_NULL_NODE)
 	{
-		m_invalidNodes.clear();
+		root = sibling;
+	}
+	else
+	{
+		AABBTreeNode& grandParentNode = m_nodes[grandParent];
+		grandParentNode.children[grandParentNode.children[0] == parent ? 0 : 1] = sibling;
+		RefitFrom(grandParent, root);
+	}
 
-		GetInvalidNodes(m_root);
+	FreeNode(parent);
+	m_nodes[node].parent = AABB_NULL_NODE;
+}
 
-		const std::string str = "Invalid Nodes : " + std::to_string(m_invalidNodes.size());
-		gVars->pRenderer->DisplayText(str, 50, 100);
+void CBroadPhaseAABBTree::RefitFrom(int32_t node, int32_t& root)
+{
+	/** Walk up the re-insert path, rotating unbalanced nodes before refitting them **/
+	while (node != AABB_NULL_NODE)
+	{
+		node = Balance(node, root);
 
-		for (AABBTreeNode* node : m_invalidNodes)
-		{
-			AABBTreeNode* parent = node->parent;
-			AABBTreeNode* sibling = node->GetSibling();
+		AABBTreeNode& treeNode = m_nodes[node];
+		treeNode.height = 1 + Max(m_nodes[treeNode.children[0]].height, m_nodes[treeNode.children[1]].height);
+		UpdateFatAABB(treeNode);
 
-			AABBTreeNode** parentLink;
-			if (parent->parent)
-			{
-				if (parent == parent->parent->children[0])
-				{
-					parentLink = &parent->parent->children[0];
-				}
-				else
-				{
-					parentLink = &parent->parent->children[1];
-				}
-				sibling->parent = parent->parent;
-			}
-			else
-			{
-				parentLink = &m_root;
-				sibling->parent = nullptr;
+		node = treeNode.parent;
+	}
+}
 
-			}
+int32_t CBroadPhaseAABBTree::Balance(int32_t node, int32_t& root)
+{
+	const AABBTreeNode& treeNode = m_nodes[node];
+	if (treeNode.IsLeaf() || treeNode.height < 2) return node;
 
-			*parentLink = sibling;
+	const int32_t balance = m_nodes[treeNode.children[1]].height - m_nodes[treeNode.children[0]].height;
 
-			parent->children[0] = parent->children[1] = nullptr;
+	if (balance > 1) return Rotate(node, 1, root);
+	if (balance < -1) return Rotate(node, 0, root);
+	return node;
+}
 
-			delete parent;
+int32_t CBroadPhaseAABBTree::Rotate(int32_t node, int32_t childSlot, int32_t& root)
+{
+	/** The taller child C of A is promoted in place of A, A keeps its other child and takes the shortest grandchild **/
+	const int32_t iA = node;
+	const int32_t iC = m_nodes[iA].children[childSlot];
+	const int32_t iB = m_nodes[iA].children[1 - childSlot];
+	const int32_t iF = m_nodes[iC].children[0];
+	const int32_t iG = m_nodes[iC].children[1];
 
-			UpdateFatAABB(node);
-			InsertNode(node, &m_root);
-		}
-		m_invalidNodes.clear();
+	AABBTreeNode& A = m_nodes[iA];
+	AABBTreeNode& B = m_nodes[iB];
+	AABBTreeNode& C = m_nodes[iC];
+	AABBTreeNode& F = m_nodes[iF];
+	AABBTreeNode& G = m_nodes[iG];
+
+	C.parent = A.parent;
+	A.parent = iC;
+
+	if (C.parent == AABB_NULL_NODE)
+	{
+		root = iC;
+	}
+	else
+	{
+		AABBTreeNode& parent = m_nodes[C.parent];
+		parent.children[parent.children[0] == iA ? 0 : 1] = iC;
 	}
+
+	const bool keepF = F.height > G.height;
+	const int32_t iKept = keepF ? iF : iG;
+	const int32_t iMoved = keepF ? iG : iF;
+
+	C.children[0] = iA;
+	C.children[1] = iKept;
+	A.children[childSlot] = iMoved;
+	m_nodes[iMoved].parent = iA;
+
+	A.fatAABB = B.fatAABB.Merge(m_nodes[iMoved].fatAABB);
+	A.height = 1 + Max(B.height, m_nodes[iMoved].height);
+	C.fatAABB = A.fatAABB.Merge(m_nodes[iKept].fatAABB);
+	C.height = 1 + Max(A.height, m_nodes[iKept].height);
+
+	return iC;
 }
 
-void CBroadPhaseAABBTree::DrawGizmos()
+int32_t CBroadPhaseAABBTree::GetTreeHeight() const
 {
-	if (!m_root) return;
-	DrawPolyAABB(m_root);
-	DrawFatAABB(m_root);
+	return (m_root == AABB_NULL_NODE) ? 0 : m_nodes[m_root].height;
 }
 
-AABB* CBroadPhaseAABBTree::BuildPolyAABB(const CPolygonPtr& poly) const
+float CBroadPhaseAABBTree::GetTreeSAHCost() const
 {
-	const size_t size = poly->points.size();
-	AABB* polyAABB = new AABB;
-	polyAABB->polyRef = poly;
-	std::vector<Vec2> transformatedPoints;
+	if (m_root == AABB_NULL_NODE) return 0.0f;
 
-	for (const Vec2 point : poly->points)
-		transformatedPoints.push_back(poly->TransformPoint(point));
+	float cost = 0.0f;
+	std::vector<int32_t> stack;
+	stack.push_back(m_root);
 
-	for (int pointIndex = 0; pointIndex < size; ++pointIndex)
+	while (!stack.empty())
 	{
-		if (polyAABB->maxX < transformatedPoints[pointIndex].x) polyAABB->maxX = transformatedPoints[pointIndex].x;
-		if (polyAABB->minX > transformatedPoints[pointIndex].x) polyAABB->minX = transformatedPoints[pointIndex].x;
-		if (polyAABB->maxY < transformatedPoints[pointIndex].y) polyAABB->maxY = transformatedPoints[pointIndex].y;
-		if (polyAABB->minY > transformatedPoints[pointIndex].y) polyAABB->minY = transformatedPoints[pointIndex].y;
+		const AABBTreeNode& treeNode = m_nodes[stack.back()];
+		stack.pop_back();
+
+		if (treeNode.IsLeaf()) continue;
+
+		cost += treeNode.fatAABB.Perimeter();
+		stack.push_back(treeNode.children[0]);
+		stack.push_back(treeNode.children[1]);
 	}
-	return polyAABB;
+	return cost;
 }
 
-void CBroadPhaseAABBTree::UpdatePolyAABB(AABBTreeNode* node) const
+void CBroadPhaseAABBTree::Update()
 {
-	if (node->IsLeaf())
+	if (m_root == AABB_NULL_NODE)
 	{
-		const size_t size = node->polyAABB->polyRef->points.size();
-		CPolygonPtr poly = node->polyAABB->polyRef;
+		UpdateStaticProxies();
+		return;
+	}
 
-		std::vector<Vec2> transformatedPoints;
+	/** Sleeping bodies don't move, their boxes stay valid **/
+	for (int32_t leaf : m_leaves)
+	{
+		if (m_nodes[leaf].polyRef->IsAwake())
+			UpdatePolyAABB(m_nodes[leaf]);
+	}
 
-		for (Vec2 point : poly->points)
-		{
-			transformatedPoints.push_back(poly->TransformPoint(point));
-		}
+	m_invalidNodes.clear();
 
-		float _maxX = -FLT_MAX;
-		float _minX = FLT_MAX;
-		float _maxY = -FLT_MAX;
-		float _minY = FLT_MAX;
+	GetInvalidNodes();
 
-		for (size_t pointIndex = 0; pointIndex < size; ++pointIndex)
-		{
-			if (_maxX < transformatedPoints[pointIndex].x) _maxX = transformatedPoints[pointIndex].x;
-			if (_minX > transformatedPoints[pointIndex].x) _minX = transformatedPoints[pointIndex].x;
-			if (_maxY < transformatedPoints[pointIndex].y) _maxY = transformatedPoints[pointIndex].y;
-			if (_minY > transformatedPoints[pointIndex].y) _minY = transformatedPoints[pointIndex].y;
-		}
+	m_reinsertRate = (float)m_invalidNodes.size() / (float)m_leaves.size();
+	m_averageReinsertRate += (m_reinsertRate - m_averageReinsertRate) * 0.05f;
 
-		node->polyAABB->maxX = _maxX;
-		node->polyAABB->maxY = _maxY;
-		node->polyAABB->minX = _minX;
-		node->polyAABB->minY = _minY;
+	if (gVars->bDebug && gVars->pPhysicEngine->IsDebugStep())
+	{
+		const std::string str = "Invalid Nodes : " + std::to_string(m_invalidNodes.size())
+			+ ", reinsert rate : " + std::to_string(m_reinsertRate * 100.0f) + "% (avg " + std::to_string(m_averageReinsertRate * 100.0f) + "%)";
+		gVars->pRenderer->DisplayText(str, 50, 100);
+	}
+
+	/** Detaching frees one branch node and inserting takes it back, so the pool stays the same size **/
+	for (int32_t node : m_invalidNodes)
+	{
+		DetachNode(node, m_root);
+		UpdateFatAABB(m_nodes[node]);
+		InsertNode(node, m_root);
+		m_moveBuffer.push_back(node);
+	}
+	m_invalidNodes.clear();
 
+	UpdateStaticProxies();
+	CheckTreeQuality();
+}
 
+void CBroadPhaseAABBTree::UpdateStaticProxies()
+{
+	/** Statics skip the refit, a transform comparison is enough to catch the rare ones moved by tools or scenes **/
+	for (SStaticProxy& proxy : m_staticProxies)
+	{
+		AABBTreeNode& node = m_nodes[proxy.leaf];
+		const CPolygonPtr& poly = node.polyRef;
+
+		if (poly->position == proxy.position && poly->rotation.X == proxy.rotation.X && poly->rotation.Y == proxy.rotation.Y)
+			continue;
+
+		proxy.position = poly->position;
+		proxy.rotation = poly->rotation;
+
+		UpdatePolyAABB(node);
+		UpdateFatAABB(node);
+		DetachNode(proxy.leaf, m_staticRoot);
+		InsertNode(proxy.leaf, m_staticRoot);
+		m_moveBuffer.push_back(proxy.leaf);
+	}
+}
+
+void CBroadPhaseAABBTree::DrawGizmos()
+{
+	if (m_root != AABB_NULL_NODE)
+	{
+		DrawPolyAABB(m_root);
+		DrawFatAABB(m_root);
+	}
+
+	if (m_staticRoot != AABB_NULL_NODE)
+	{
+		DrawPolyAABB(m_staticRoot);
+		DrawFatAABB(m_staticRoot);
+	}
+}
+
+AABB CBroadPhaseAABBTree::BuildPolyAABB(const CPolygonPtr& poly) const
+{
+	return ComputePolygonAABB(*poly);
+}
+
+void CBroadPhaseAABBTree::UpdatePolyAABB(AABBTreeNode& node) const
+{
+	node.polyAABB = BuildPolyAABB(node.polyRef);
+}
+
+void CBroadPhaseAABBTree::UpdateFatAABB(AABBTreeNode& node) const
+{
+	if (node.IsLeaf() && node.isStatic)
+	{
+		/** Static leaves are only re-inserted when their transform changes, a margin would just widen the walls **/
+		node.fatAABB = node.polyAABB;
+	}
+	else if (node.IsLeaf())
+	{
+		const CPolygon& poly = *node.polyRef;
+		const float lookAhead = gVars->pPhysicEngine->GetTimeStep() * m_predictionFrames;
+		const float extent = Max(node.polyAABB.maxX - node.polyAABB.minX, node.polyAABB.maxY - node.polyAABB.minY);
+
+		/** Rotation moves the vertices by up to half the extent times the angle swept **/
+		const float margin = Max(m_minMargin, extent * (m_marginRatio + 0.5f * fabsf(poly.angularVelocity) * lookAhead));
+		const Vec2 displacement = poly.speed * lookAhead;
+
+		node.fatAABB.maxX = node.polyAABB.maxX + margin + Max(displacement.x, 0.0f);
+		node.fatAABB.minX = node.polyAABB.minX - margin + Min(displacement.x, 0.0f);
+		node.fatAABB.maxY = node.polyAABB.maxY + margin + Max(displacement.y, 0.0f);
+		node.fatAABB.minY = node.polyAABB.minY - margin + Min(displacement.y, 0.0f);
 	}
 	else
 	{
-		UpdatePolyAABB(node->children[0]);
-		UpdatePolyAABB(node->children[1]);
+		node.fatAABB = m_nodes[node.children[0]].fatAABB.Merge(m_nodes[node.children[1]].fatAABB);
 	}
 }
 
-void CBroadPhaseAABBTree::UpdateFatAABB(AABBTreeNode* node) const
+void CBroadPhaseAABBTree::GetInvalidNodes()
 {
-	if (node->IsLeaf())
+	for (int32_t leaf : m_leaves)
 	{
-		node->fatAABB->maxX = node->polyAABB->maxX + m_margin;
-		node->fatAABB->minX = node->polyAABB->minX - m_margin;
-		node->fatAABB->maxY = node->polyAABB->maxY + m_margin;
-		node->fatAABB->minY = node->polyAABB->minY - m_margin;
+		const AABBTreeNode& node = m_nodes[leaf];
+		if (!node.fatAABB.Contain(node.polyAABB))
+		{
+			m_invalidNodes.push_back(leaf);
+		}
+	}
+}
+
+
+void CBroadPhaseAABBTree::ComputePairs(int32_t brother, int32_t sister, std::vector<SPolygonPair>& pairs) const
+{
+	const AABBTreeNode& brotherNode = m_nodes[brother];
+	const AABBTreeNode& sisterNode = m_nodes[sister];
+
+	/** Fat boxes enclose the whole subtree, nothing below can overlap if they don't **/
+	if (!brotherNode.fatAABB.Collide(sisterNode.fatAABB)) return;
+
+	if (brotherNode.IsLeaf())
+	{
+		if (sisterNode.IsLeaf())
+		{
+			if (brotherNode.polyAABB.Collide(sisterNode.polyAABB))
+			{
+				pairs.emplace_back(brotherNode.polyRef, sisterNode.polyRef);
+			}
+		}
+		else
+		{
+			ComputePairs(brother, sisterNode.children[0], pairs);
+			ComputePairs(brother, sisterNode.children[1], pairs);
+		}
 	}
 	else
 	{
-		delete node->fatAABB;
-		node->fatAABB = node->children[0]->fatAABB->Merge(node->children[1]->fatAABB);
+		if (sisterNode.IsLeaf())
+		{
+			ComputePairs(brotherNode.children[0], sister, pairs);
+			ComputePairs(brotherNode.children[1], sister, pairs);
+		}
+		else
+		{
+			ComputePairs(brotherNode.children[0], sisterNode.children[0], pairs);
+			ComputePairs(brotherNode.children[0], sisterNode.children[1], pairs);
+			ComputePairs(brotherNode.children[1], sisterNode.children[0], pairs);
+			ComputePairs(brotherNode.children[1], sisterNode.children[1], pairs);
+		}
 	}
 }
 
-/*bool CBroadPhaseAABBTree::CheckPolySizes(AABB* poly, AABB* fat) const
+void CBroadPhaseAABBTree::ComputeSelfPairs(int32_t node, std::vector<SPolygonPair>& pairs) const
+{
+	const AABBTreeNode& treeNode = m_nodes[node];
+	if (treeNode.IsLeaf()) return;
+
+	ComputeSelfPairs(treeNode.children[0], pairs);
+	ComputeSelfPairs(treeNode.children[1], pairs);
+	ComputePairs(treeNode.children[0], treeNode.children[1], pairs);
+}
+
+void CBroadPhaseAABBTree::ComputeAllPairs()
 {
-	return poly->maxX + m_margin == fat->maxX
-		|| poly->maxY + m_margin == fat->maxY
-		|| poly->minX + m_margin == fat->minX
-		|| poly->minY + m_margin == fat->minY;
-}*/
+	ComputeSelfPairs(m_root, m_nodePairs);
+
+	/** Static tree is only ever crossed against the dynamic one **/
+	if (m_staticRoot != AABB_NULL_NODE)
+		ComputePairs(m_root, m_staticRoot, m_nodePairs);
+}
 
-void CBroadPhaseAABBTree::GetInvalidNodes(AABBTreeNode* node)
+void CBroadPhaseAABBTree::ComputeAllPairsParallel()
 {
-	if (node->IsLeaf())
+	/** Tasks only depend on the tree, cut a fixed number of levels below the dynamic root **/
+	const int32_t splitHeight = Max(m_nodes[m_root].height - m_pairTaskDepth, 0);
+
+	m_pairTasks.clear();
+	AddPairTasks(m_root, AABB_NULL_NODE, splitHeight);
+	if (m_staticRoot != AABB_NULL_NODE)
+		AddPairTasks(m_root, m_staticRoot, splitHeight);
+
+	if (m_pairTaskBuffers.size() < m_pairTasks.size())
+		m_pairTaskBuffers.resize(m_pairTasks.size());
+
+	gVars->pThreadPool->ParallelFor(m_pairTasks.size(), [this](size_t taskIndex)
+	{
+		const SPairTask& task = m_pairTasks[taskIndex];
+		std::vector<SPolygonPair>& pairs = m_pairTaskBuffers[taskIndex].pairs;
+		pairs.clear();
+
+		if (task.nodeB == AABB_NULL_NODE)
+			ComputeSelfPairs(task.nodeA, pairs);
+		else
+			ComputePairs(task.nodeA, task.nodeB, pairs);
+	});
+
+	size_t pairCount = 0;
+	for (size_t taskIndex = 0; taskIndex < m_pairTasks.size(); ++taskIndex)
+		pairCount += m_pairTaskBuffers[taskIndex].pairs.size();
+
+	m_nodePairs.reserve(pairCount);
+	for (size_t taskIndex = 0; taskIndex < m_pairTasks.size(); ++taskIndex)
+	{
+		std::vector<SPolygonPair>& pairs = m_pairTaskBuffers[taskIndex].pairs;
+		m_nodePairs.insert(m_nodePairs.end(), pairs.begin(), pairs.end());
+	}
+}
+
+void CBroadPhaseAABBTree::AddPairTasks(int32_t nodeA, int32_t nodeB, int32_t splitHeight)
+{
+	const AABBTreeNode& treeNodeA = m_nodes[nodeA];
+
+	if (nodeB == AABB_NULL_NODE)
 	{
-		if (!node->fatAABB->Contain(node->polyAABB))
+		/** Self pairs of a subtree = self pairs of both children + pairs across them **/
+		if (treeNodeA.IsLeaf() || treeNodeA.height <= splitHeight)
 		{
-			m_invalidNodes.push_back(node);
+			m_pairTasks.push_back({ nodeA, AABB_NULL_NODE });
+			return;
 		}
+
+		AddPairTasks(treeNodeA.children[0], AABB_NULL_NODE, splitHeight);
+		AddPairTasks(treeNodeA.children[1], AABB_NULL_NODE, splitHeight);
+		AddPairTasks(treeNodeA.children[0], treeNodeA.children[1], splitHeight);
+		return;
+	}
+
+	const AABBTreeNode& treeNodeB = m_nodes[nodeB];
+	if (!treeNodeA.fatAABB.Collide(treeNodeB.fatAABB)) return;
+
+	if (Max(treeNodeA.height, treeNodeB.height) <= splitHeight)
+	{
+		m_pairTasks.push_back({ nodeA, nodeB });
+		return;
+	}
+
+	/** Split the taller side, the other one is kept whole **/
+	if (treeNodeB.IsLeaf() || (!treeNodeA.IsLeaf() && treeNodeA.height >= treeNodeB.height))
+	{
+		AddPairTasks(treeNodeA.children[0], nodeB, splitHeight);
+		AddPairTasks(treeNodeA.children[1], nodeB, splitHeight);
 	}
 	else
 	{
-		GetInvalidNodes(node->children[0]);
-		GetInvalidNodes(node->children[1]);
+		AddPairTasks(nodeA, treeNodeB.children[0], splitHeight);
+		AddPairTasks(nodeA, treeNodeB.children[1], splitHeight);
 	}
 }
 
+bool CBroadPhaseAABBTree::UseThreadPool() const
+{
+	return gVars->pThreadPool && gVars->pThreadPool->GetThreadCount() > 1 && m_leaves.size() >= m_parallelPairThreshold;
+}
 
-void CBroadPhaseAABBTree::ComputePairs(AABBTreeNode* brother, AABBTreeNode* sister)
+void CBroadPhaseAABBTree::QueryMovedProxies()
 {
-	if (brother->IsLeaf())
+	m_newPairs.clear();
+
+	if (UseThreadPool() && m_moveBuffer.size() > m_queryTaskSize)
 	{
-		if (sister->IsLeaf())
+		/** Fixed size chunks of the move buffer, keys are sorted below so the merge order does not matter **/
+		const size_t taskCount = (m_moveBuffer.size() + m_queryTaskSize - 1) / m_queryTaskSize;
+		if (m_pairTaskBuffers.size() < taskCount)
+			m_pairTaskBuffers.resize(taskCount);
+
+		gVars->pThreadPool->ParallelFor(taskCount, [this](size_t taskIndex)
 		{
-			if (brother->polyAABB->Collide(sister->polyAABB))
+			SPairTaskBuffer& buffer = m_pairTaskBuffers[taskIndex];
+			buffer.keys.clear();
+
+			const size_t end = Min((taskIndex + 1) * m_queryTaskSize, m_moveBuffer.size());
+			for (size_t index = taskIndex * m_queryTaskSize; index < end; ++index)
 			{
-				m_nodePairs.emplace_back(brother->polyAABB->polyRef, sister->polyAABB->polyRef);
+				const int32_t leaf = m_moveBuffer[index];
+				QueryProxy(leaf, m_root, buffer.stack, buffer.keys);
+				if (!m_nodes[leaf].isStatic)
+					QueryProxy(leaf, m_staticRoot, buffer.stack, buffer.keys);
 			}
-		}
-		else
-		{
-			CrossChild(sister);
-			ComputePairs(brother, sister->children[0]);
-			ComputePairs(brother, sister->children[1]);
+		});
 
+		for (size_t taskIndex = 0; taskIndex < taskCount; ++taskIndex)
+		{
+			const std::vector<uint64_t>& keys = m_pairTaskBuffers[taskIndex].keys;
+			m_newPairs.insert(m_newPairs.end(), keys.begin(), keys.end());
 		}
 	}
 	else
 	{
-		if (sister->IsLeaf())
+		for (int32_t leaf : m_moveBuffer)
 		{
-			CrossChild(brother);
-			ComputePairs(brother->children[0], sister);
-			ComputePairs(brother->children[1], sister);
+			/** Moved statics only look for dynamic bodies, moved dynamics look in both trees **/
+			QueryProxy(leaf, m_root, m_queryStack, m_newPairs);
+			if (!m_nodes[leaf].isStatic)
+				QueryProxy(leaf, m_staticRoot, m_queryStack, m_newPairs);
 		}
-		else
-		{
-			CrossChild(brother);
-			CrossChild(sister);
+	}
+	m_moveBuffer.clear();
+
+	if (gVars->bDebug && gVars->pPhysicEngine->IsDebugStep())
+	{
+		const std::string str = "New Pairs : " + std::to_string(m_newPairs.size());
+		gVars->pRenderer->DisplayText(str, 50, 200);
+	}
+
+	if (m_newPairs.empty()) return;
 
-			ComputePairs(brother->children[0], sister->children[0]);
-			ComputePairs(brother->children[0], sister->children[1]);
-			ComputePairs(brother->children[1], sister->children[0]);
-			ComputePairs(brother->children[1], sister->children[1]);
+	/** Two moved proxies find each other twice, sort and merge the new keys into the persistent set without duplicates **/
+	std::sort(m_newPairs.begin(), m_newPairs.end());
+	m_newPairs.erase(std::unique(m_newPairs.begin(), m_newPairs.end()), m_newPairs.end());
 
+	const size_t oldCount = m_persistentPairs.size();
+	m_persistentPairs.insert(m_persistentPairs.end(), m_newPairs.begin(), m_newPairs.end());
+	std::inplace_merge(m_persistentPairs.begin(), m_persistentPairs.begin() + oldCount, m_persistentPairs.end());
+	m_persistentPairs.erase(std::unique(m_persistentPairs.begin(), m_persistentPairs.end()), m_persistentPairs.end());
+}
+
+void CBroadPhaseAABBTree::QueryProxy(int32_t leaf, int32_t root, std::vector<int32_t>& stack, std::vector<uint64_t>& keys) const
+{
+	if (root == AABB_NULL_NODE) return;
+
+	const AABB& queryAABB = m_nodes[leaf].fatAABB;
+
+	stack.clear();
+	stack.push_back(root);
+
+	while (!stack.empty())
+	{
+		const int32_t node = stack.back();
+		stack.pop_back();
+
+		const AABBTreeNode& treeNode = m_nodes[node];
+		if (node == leaf || !treeNode.fatAABB.Collide(queryAABB)) continue;
+
+		if (treeNode.IsLeaf())
+		{
+			const uint64_t minLeaf = (uint64_t)Min(leaf, node);
+			const uint64_t maxLeaf = (uint64_t)Max(leaf, node);
+			keys.push_back((minLeaf << 32) | maxLeaf);
+		}
+		else
+		{
+			stack.push_back(treeNode.children[0]);
+			stack.push_back(treeNode.children[1]);
 		}
 	}
-	
 }
 
-void CBroadPhaseAABBTree::CrossChild(AABBTreeNode* node)
+void CBroadPhaseAABBTree::UpdatePersistentPairs()
 {
-	if (node->crossed) return;
-	node->crossed = true;
-	ComputePairs(node->children[0], node->children[1]);
+	/** Drop pairs whose fat boxes separated and report the ones whose tight boxes touch **/
+	size_t keptCount = 0;
+	for (const uint64_t key : m_persistentPairs)
+	{
+		const AABBTreeNode& nodeA = m_nodes[(int32_t)(key >> 32)];
+		const AABBTreeNode& nodeB = m_nodes[(int32_t)(key & 0xFFFFFFFF)];
+
+		if (!nodeA.fatAABB.Collide(nodeB.fatAABB)) continue;
+
+		m_persistentPairs[keptCount++] = key;
+
+		if (nodeA.polyAABB.Collide(nodeB.polyAABB))
+		{
+			m_nodePairs.emplace_back(nodeA.polyRef, nodeB.polyRef);
+		}
+	}
+	m_persistentPairs.resize(keptCount);
 }
 
-void CBroadPhaseAABBTree::ClearCrossFlag(AABBTreeNode* node)
+void CBroadPhaseAABBTree::RemoveProxyPairs(int32_t leaf)
 {
-	node->crossed = false;
-	if (node->IsLeaf()) return;
-	ClearCrossFlag(node->children[0]);
-	ClearCrossFlag(node->children[1]);
+	m_persistentPairs.erase(std::remove_if(m_persistentPairs.begin(), m_persistentPairs.end(), [leaf](uint64_t key)
+	{
+		return (int32_t)(key >> 32) == leaf || (int32_t)(key & 0xFFFFFFFF) == leaf;
+	}), m_persistentPairs.end());
+
+	m_moveBuffer.erase(std::remove(m_moveBuffer.begin(), m_moveBuffer.end(), leaf), m_moveBuffer.end());
 }
 
-void CBroadPhaseAABBTree::DrawFatAABB(AABBTreeNode* node)
+void CBroadPhaseAABBTree::DrawFatAABB(int32_t node)
 {
+	const AABBTreeNode& treeNode = m_nodes[node];
 	Vec2 gizmosPoints[4];
 
-	gizmosPoints[0] = Vec2(node->fatAABB->minX, node->fatAABB->maxY);
-	gizmosPoints[1] = Vec2(node->fatAABB->maxX, node->fatAABB->maxY);
-	gizmosPoints[2] = Vec2(node->fatAABB->maxX, node->fatAABB->minY);
-	gizmosPoints[3] = Vec2(node->fatAABB->minX, node->fatAABB->minY);
+	gizmosPoints[0] = Vec2(treeNode.fatAABB.minX, treeNode.fatAABB.maxY);
+	gizmosPoints[1] = Vec2(treeNode.fatAABB.maxX, treeNode.fatAABB.maxY);
+	gizmosPoints[2] = Vec2(treeNode.fatAABB.maxX, treeNode.fatAABB.minY);
+	gizmosPoints[3] = Vec2(treeNode.fatAABB.minX, treeNode.fatAABB.minY);
 
 	const int gizmosMaxPoint = 4;
 
 	float r, g, b;
-	if (node->IsLeaf())
+	if (treeNode.IsLeaf())
 	{
 		r = 1.f;
 		g = 0.0f;
@@ -365,21 +1053,22 @@ void CBroadPhaseAABBTree::DrawFatAABB(AABBTreeNode* node)
 	for (int index = 0; index < gizmosMaxPoint; ++index)
 		gVars->pRenderer->DrawLine(gizmosPoints[index], gizmosPoints[(index + 1) % gizmosMaxPoint], r, g, b);
 
-	if (node->IsLeaf()) return;
-	DrawFatAABB(node->children[0]);
-	DrawFatAABB(node->children[1]);
+	if (treeNode.IsLeaf()) return;
+	DrawFatAABB(treeNode.children[0]);
+	DrawFatAABB(treeNode.children[1]);
 }
 
-void CBroadPhaseAABBTree::DrawPolyAABB(AABBTreeNode* node)
+void CBroadPhaseAABBTree::DrawPolyAABB(int32_t node)
 {
-	if (node->IsLeaf())
+	const AABBTreeNode& treeNode = m_nodes[node];
+	if (treeNode.IsLeaf())
 	{
 		Vec2 gizmosPoints[4];
 
-		gizmosPoints[0] = (Vec2(node->polyAABB->minX, node->polyAABB->maxY));
-		gizmosPoints[1] = (Vec2(node->polyAABB->maxX, node->polyAABB->maxY));
-		gizmosPoints[2] = (Vec2(node->polyAABB->maxX, node->polyAABB->minY));
-		gizmosPoints[3] = (Vec2(node->polyAABB->minX, node->polyAABB->minY));
+		gizmosPoints[0] = (Vec2(treeNode.polyAABB.minX, treeNode.polyAABB.maxY));
+		gizmosPoints[1] = (Vec2(treeNode.polyAABB.maxX, treeNode.polyAABB.maxY));
+		gizmosPoints[2] = (Vec2(treeNode.polyAABB.maxX, treeNode.polyAABB.minY));
+		gizmosPoints[3] = (Vec2(treeNode.polyAABB.minX, treeNode.polyAABB.minY));
 
 		const int gizmosMaxPoint = 4;
 
@@ -388,8 +1077,7 @@ void CBroadPhaseAABBTree::DrawPolyAABB(AABBTreeNode* node)
 	}
 	else
 	{
-		DrawPolyAABB(node->children[0]);
-		DrawPolyAABB(node->children[1]);
+		DrawPolyAABB(treeNode.children[0]);
+		DrawPolyAABB(treeNode.children[1]);
 	}
 }
-
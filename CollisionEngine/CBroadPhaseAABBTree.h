@@ -10,28 +10,151 @@ public:
 
 	void Init() override;
 	void GetCollidingPairsToCheck(std::vector<SPolygonPair>& pairsToCheck) override;
-	void InsertNode(AABBTreeNode* node, AABBTreeNode** parent) const;
-	void Add(AABB* trueAABB);
-	void Remove(AABBTreeNode* deleteMe);
+	void InsertNode(int32_t node, int32_t& root);
+	int32_t Add(const CPolygonPtr& poly);
+	void Remove(int32_t deleteMe);
 	void Update();
 	void DrawGizmos() override;
 
+	/** Queries walk both trees on the fat boxes, which still enclose bodies nudged by the collision response. Not reentrant **/
+	void QueryAABB(const AABB& aabb, const TQueryCallback& callback) override;
+	void RayCast(const SRayCastInput& input, const TRayCastCallback& callback) override;
+
+	/** Incremental mode only queries re-inserted proxies and keeps the pairs found on previous frames **/
+	void SetIncrementalPairs(bool incremental);
+
+	/** Fraction of dynamic proxies re-inserted on the last update, and its running average **/
+	float GetReinsertRate() const;
+	float GetAverageReinsertRate() const;
+
+	/** Quality of the dynamic tree : height and SAH cost (sum of the internal node perimeters) **/
+	int32_t GetTreeHeight() const;
+	float GetTreeSAHCost() const;
+
+	/** Top down binned SAH build of the dynamic tree, also run on Init for both trees **/
+	void Rebuild();
+	/** Rebuild automatically once the SAH cost exceeds ratio * cost of the last build, 0 disables it **/
+	void SetRebuildThreshold(float ratio);
+
 private:
-	AABB* BuildPolyAABB(const CPolygonPtr& poly) const;
-	void UpdatePolyAABB(AABBTreeNode* node) const;
-	void UpdateFatAABB(AABBTreeNode* node) const;
-	void GetInvalidNodes(AABBTreeNode* node);
-	void ComputePairs(AABBTreeNode* brother, AABBTreeNode* sister);
-	void CrossChild(AABBTreeNode* node);
-	void ClearCrossFlag(AABBTreeNode* node);
+	int32_t CreateLeaf(const CPolygonPtr& poly);
+	int32_t BuildTree(std::vector<int32_t>& leaves, int32_t root);
+	int32_t BuildSubtree(int32_t* leaves, int32_t count, const int32_t* internalNodes);
+	int32_t BuildSubtreeParallel(int32_t* leaves, int32_t count, const int32_t* internalNodes);
+	void SplitBuildTasks(int32_t* leaves, int32_t count, const int32_t* internalNodes, int32_t depth);
+	/** SAH split of the leaves, returns the left side count **/
+	int32_t SplitLeaves(int32_t* leaves, int32_t count) const;
+	void LinkBranch(int32_t node, int32_t leftChild, int32_t rightChild);
+	void CheckTreeQuality();
+
+	int32_t AllocateNode();
+	void FreeNode(int32_t node);
+	void DetachNode(int32_t node, int32_t& root);
+	void RefitFrom(int32_t node, int32_t& root);
+	int32_t Balance(int32_t node, int32_t& root);
+	int32_t Rotate(int32_t node, int32_t childSlot, int32_t& root);
+
+	AABB BuildPolyAABB(const CPolygonPtr& poly) const;
+	void UpdatePolyAABB(AABBTreeNode& node) const;
+	void UpdateFatAABB(AABBTreeNode& node) const;
+	void UpdateStaticProxies();
+	void GetInvalidNodes();
+	void ComputePairs(int32_t brother, int32_t sister, std::vector<SPolygonPair>& pairs) const;
+	void ComputeSelfPairs(int32_t node, std::vector<SPolygonPair>& pairs) const;
+	void ComputeAllPairs();
+	void ComputeAllPairsParallel();
+	void AddPairTasks(int32_t nodeA, int32_t nodeB, int32_t splitHeight);
+	bool UseThreadPool() const;
+
+	bool QueryTree(int32_t root, const AABB& aabb, const TQueryCallback& callback);
+	bool RayCastTree(int32_t root, SRayCastInput& input, const TRayCastCallback& callback);
+
+	void QueryMovedProxies();
+	void QueryProxy(int32_t leaf, int32_t root, std::vector<int32_t>& stack, std::vector<uint64_t>& keys) const;
+	void UpdatePersistentPairs();
+	void RemoveProxyPairs(int32_t leaf);
 
-	void DrawFatAABB(AABBTreeNode* node);
-	void DrawPolyAABB(AABBTreeNode* node);
+	void DrawFatAABB(int32_t node);
+	void DrawPolyAABB(int32_t node);
 
 
-	AABBTreeNode*				m_root;
-	std::vector<AABBTreeNode*>	m_invalidNodes;
+	/** Node pool, freed nodes are chained through their parent index and recycled **/
+	std::vector<AABBTreeNode>	m_nodes;
+	int32_t						m_freeList = AABB_NULL_NODE;
+	int32_t						m_root = AABB_NULL_NODE;
+
+	/** Static bodies (density == 0) live in their own tree, never refit unless their transform is changed from outside **/
+	struct SStaticProxy
+	{
+		int32_t	leaf;
+		Vec2	position;
+		Mat2	rotation;
+	};
+	int32_t						m_staticRoot = AABB_NULL_NODE;
+	std::vector<SStaticProxy>	m_staticProxies;
+
+	/** Dynamic leaves only **/
+	std::vector<int32_t>		m_leaves;
+	std::vector<int32_t>		m_invalidNodes;
 	std::vector<SPolygonPair>	m_nodePairs;
-	const float					m_margin = 0.2f;
-};
 
+	/** Move buffer : leaves added or re-inserted since the last pair update **/
+	std::vector<int32_t>		m_moveBuffer;
+	/** Sorted (leafA << 32 | leafB) keys, leafA < leafB, of every pair whose fat AABBs overlap **/
+	std::vector<uint64_t>		m_persistentPairs;
+	std::vector<uint64_t>		m_newPairs;
+	std::vector<int32_t>		m_queryStack;
+	bool						m_incrementalPairs = true;
+
+	/** Parallel pair generation : the traversal is cut into subtree tasks, each writing to its own buffer,
+	buffers are merged in task order so the pair order does not depend on the thread count **/
+	struct SPairTask
+	{
+		int32_t	nodeA;
+		int32_t	nodeB;	// AABB_NULL_NODE for the self pairs of nodeA
+	};
+	struct SPairTaskBuffer
+	{
+		std::vector<SPolygonPair>	pairs;
+		std::vector<uint64_t>		keys;
+		std::vector<int32_t>		stack;
+	};
+	std::vector<SPairTask>			m_pairTasks;
+	std::vector<SPairTaskBuffer>	m_pairTaskBuffers;
+	const size_t					m_parallelPairThreshold = 512;
+	const int32_t					m_pairTaskDepth = 6;
+	const size_t					m_queryTaskSize = 64;
+
+	/** Fat box = tight box + size relative margin, stretched along the displacement predicted for the next frames **/
+	const float					m_minMargin = 0.01f;
+	const float					m_marginRatio = 0.2f;
+	const float					m_predictionFrames = 2.0f;
+
+	/** Binned SAH build settings, trees bigger than the parallel threshold are split m_buildTaskDepth levels deep
+	and the subtrees below are built on the thread pool **/
+	static const int32_t		s_binCount = 16;
+	const int32_t				m_parallelBuildThreshold = 4096;
+	const int32_t				m_buildTaskDepth = 4;
+	struct SBuildTask
+	{
+		int32_t*		leaves;
+		int32_t			count;
+		const int32_t*	internalNodes;
+	};
+	struct SBuildBranch
+	{
+		int32_t	node;
+		int32_t	children[2];
+	};
+	std::vector<SBuildTask>		m_buildTasks;
+	std::vector<SBuildBranch>	m_buildBranches;
+	float						m_rebuildThreshold = 1.5f;
+	float						m_lastBuildCost = 0.0f;
+	const int32_t				m_qualityCheckInterval = 60;
+	int32_t						m_framesSinceQualityCheck = 0;
+	std::vector<int32_t>		m_buildLeaves;
+	std::vector<int32_t>		m_buildNodes;
+
+	float						m_reinsertRate = 0.0f;
+	float						m_averageReinsertRate = 0.0f;
+};
@@ -0,0 +1,353 @@
+#include "CBroadPhaseGrid.h"
+#include "GlobalVariables.h"
+#include "World.h"
+#include "Renderer.h"
+#include <string>
+#include <cmath>
+
+CBroadPhaseGrid::CBroadPhaseGrid(float cellSize)
+{
+	SetCellSize(cellSize);
+}
+
+CBroadPhaseGrid::~CBroadPhaseGrid()
+{
+}
+
+void CBroadPhaseGrid::Init()
+{
+	const size_t polyCount = gVars->pWorld->GetPolygonCount();
+
+	m_polygons.clear();
+	m_polygons.reserve(polyCount);
+	for (size_t index = 0; index < polyCount; ++index)
+	{
+		m_polygons.push_back(gVars->pWorld->GetPolygon(index));
+	}
+	m_aabbs.resize(polyCount);
+
+	UpdateAABBs(true);
+	m_cellsValid = false;
+
+	if (m_cellSize > 0.0f) return;
+
+	/** Cells as large as the biggest dynamic body keep every dynamic body in at most four cells **/
+	float cellSize = 0.0f;
+	for (size_t index = 0; index < polyCount; ++index)
+	{
+		if (m_polygons[index]->density == 0.0f) continue;
+
+		const AABB& aabb = m_aabbs[index];
+		cellSize = Max(cellSize, Max(aabb.maxX - aabb.minX, aabb.maxY - aabb.minY));
+	}
+	SetCellSize(cellSize > 0.0f ? cellSize : 1.0f);
+}
+
+void CBroadPhaseGrid::GetCollidingPairsToCheck(std::vector<SPolygonPair>& pairsToCheck)
+{
+	RefreshCells();
+
+	/** Nothing awake moved since the last pairs (an idle pile), they are still right **/
+	if (!m_pairsValid)
+	{
+		m_pairs.clear();
+		FindPairs(m_pairs);
+		m_pairsValid = true;
+	}
+	pairsToCheck.insert(pairsToCheck.end(), m_pairs.begin(), m_pairs.end());
+	m_queryCellsValid = false;
+
+	if (gVars->bDebug && gVars->pPhysicEngine->IsDebugStep())
+	{
+		gVars->pRenderer->DisplayText("Potential Pairs : " + std::to_string(pairsToCheck.size()), 50, 150);
+		gVars->pRenderer->DisplayText("Grid cell size : " + std::to_string(m_cellSize) + ", entries : " + std::to_string(m_entries.size()), 50, 100);
+	}
+}
+
+void CBroadPhaseGrid::DrawGizmos()
+{
+	for (const SCellEntry& entry : m_entries)
+	{
+		Vec2 gizmosPoints[4];
+
+		const float minX = entry.cellX * m_cellSize;
+		const float minY = entry.cellY * m_cellSize;
+
+		gizmosPoints[0] = Vec2(minX, minY + m_cellSize);
+		gizmosPoints[1] = Vec2(minX + m_cellSize, minY + m_cellSize);
+		gizmosPoints[2] = Vec2(minX + m_cellSize, minY);
+		gizmosPoints[3] = Vec2(minX, minY);
+
+		const int gizmosMaxPoint = 4;
+
+		for (int index = 0; index < gizmosMaxPoint; ++index)
+			gVars->pRenderer->DrawLine(gizmosPoints[index], gizmosPoints[(index + 1) % gizmosMaxPoint], 0.f, 1.f, 0.f);
+	}
+}
+
+void CBroadPhaseGrid::QueryAABB(const AABB& aabb, const TQueryCallback& callback)
+{
+	BuildCellsIfNeeded();
+
+	const int32_t minX = GetCellCoord(aabb.minX);
+	const int32_t minY = GetCellCoord(aabb.minY);
+	const int32_t maxX = GetCellCoord(aabb.maxX);
+	const int32_t maxY = GetCellCoord(aabb.maxY);
+
+	/** Query covering more cells than there are entries, scanning the boxes is cheaper **/
+	if ((size_t)(maxX - minX + 1) * (size_t)(maxY - minY + 1) > m_entries.size())
+	{
+		for (size_t proxy = 0; proxy < m_aabbs.size(); ++proxy)
+		{
+			if (m_aabbs[proxy].Collide(aabb) && !callback(m_polygons[proxy]))
+				return;
+		}
+		return;
+	}
+
+	for (int32_t cellY = minY; cellY <= maxY; ++cellY)
+	{
+		for (int32_t cellX = minX; cellX <= maxX; ++cellX)
+		{
+			const uint32_t bucket = GetBucket(cellX, cellY);
+			for (uint32_t entry = m_bucketStart[bucket]; entry < m_bucketStart[bucket + 1]; ++entry)
+			{
+				const SCellEntry& cellEntry = m_entries[entry];
+				if (cellEntry.cellX != cellX || cellEntry.cellY != cellY) continue;
+
+				const AABB& proxyAABB = m_aabbs[cellEntry.proxy];
+				if (!proxyAABB.Collide(aabb)) continue;
+
+				/** Same rule as the pairs : only the cell holding the min corner of the overlap reports the body **/
+				if (GetCellCoord(Max(aabb.minX, proxyAABB.minX)) != cellX
+					|| GetCellCoord(Max(aabb.minY, proxyAABB.minY)) != cellY)
+					continue;
+
+				if (!callback(m_polygons[cellEntry.proxy]))
+					return;
+			}
+		}
+	}
+}
+
+void CBroadPhaseGrid::RayCast(const SRayCastInput& input, const TRayCastCallback& callback)
+{
+	BuildCellsIfNeeded();
+
+	if (m_rayMarks.size() != m_polygons.size())
+		m_rayMarks.assign(m_polygons.size(), m_rayMark);
+	++m_rayMark;
+
+	SRayCastInput clippedInput = input;
+	const Vec2 delta = input.to - input.from;
+
+	/** Walk the cells crossed by the ray in order (Amanatides & Woo), stop once past the clipped fraction **/
+	int32_t cellX = GetCellCoord(input.from.x);
+	int32_t cellY = GetCellCoord(input.from.y);
+	const Vec2 end = input.from + delta * input.maxFraction;
+	const int32_t endX = GetCellCoord(end.x);
+	const int32_t endY = GetCellCoord(end.y);
+
+	const int32_t stepX = (delta.x > 0.0f) ? 1 : -1;
+	const int32_t stepY = (delta.y > 0.0f) ? 1 : -1;
+	const float deltaX = (delta.x != 0.0f) ? m_cellSize / fabsf(delta.x) : FLT_MAX;
+	const float deltaY = (delta.y != 0.0f) ? m_cellSize / fabsf(delta.y) : FLT_MAX;
+	float nextX = (delta.x != 0.0f) ? ((cellX + (stepX > 0 ? 1 : 0)) * m_cellSize - input.from.x) / delta.x : FLT_MAX;
+	float nextY = (delta.y != 0.0f) ? ((cellY + (stepY > 0 ? 1 : 0)) * m_cellSize - input.from.y) / delta.y : FLT_MAX;
+
+	for (;;)
+	{
+		if (!RayCastCell(cellX, cellY, clippedInput, callback)) return;
+		if (cellX == endX && cellY == endY) return;
+
+		if (nextX < nextY)
+		{
+			if (nextX > clippedInput.maxFraction) return;
+			cellX += stepX;
+			nextX += deltaX;
+		}
+		else
+		{
+			if (nextY > clippedInput.maxFraction) return;
+			cellY += stepY;
+			nextY += deltaY;
+		}
+	}
+}
+
+bool CBroadPhaseGrid::RayCastCell(int32_t cellX, int32_t cellY, SRayCastInput& input, const TRayCastCallback& callback)
+{
+	const Vec2 delta = input.to - input.from;
+	const uint32_t bucket = GetBucket(cellX, cellY);
+
+	for (uint32_t entry = m_bucketStart[bucket]; entry < m_bucketStart[bucket + 1]; ++entry)
+	{
+		const SCellEntry& cellEntry = m_entries[entry];
+		if (cellEntry.cellX != cellX || cellEntry.cellY != cellY) continue;
+		if (m_rayMarks[cellEntry.proxy] == m_rayMark) continue;
+		m_rayMarks[cellEntry.proxy] = m_rayMark;
+
+		if (!m_aabbs[cellEntry.proxy].RayCast(input.from, delta, input.maxFraction)) continue;
+
+		const float fraction = callback(input, m_polygons[cellEntry.proxy]);
+		if (fraction == 0.0f) return false;
+		input.maxFraction = Min(input.maxFraction, fraction);
+	}
+
+	return true;
+}
+
+void CBroadPhaseGrid::BuildCellsIfNeeded()
+{
+	if (m_queryCellsValid && m_polygons.size() == gVars->pWorld->GetPolygonCount()) return;
+
+	RefreshCells();
+	m_queryCellsValid = true;
+}
+
+void CBroadPhaseGrid::RefreshCells()
+{
+	bool moved = true;
+	if (m_polygons.size() != gVars->pWorld->GetPolygonCount()) Init();
+	else moved = UpdateAABBs(false);
+
+	if (moved || !m_cellsValid)
+	{
+		BuildCells();
+		m_cellsValid = true;
+		m_pairsValid = false;
+	}
+}
+
+void CBroadPhaseGrid::SetCellSize(float cellSize)
+{
+	m_cellSize = cellSize;
+	m_invCellSize = (cellSize > 0.0f) ? 1.0f / cellSize : 0.0f;
+}
+
+float CBroadPhaseGrid::GetCellSize() const
+{
+	return m_cellSize;
+}
+
+bool CBroadPhaseGrid::UpdateAABBs(bool includeSleeping)
+{
+	/** Sleeping bodies don't move, their last box stays valid **/
+	bool moved = false;
+	for (size_t index = 0; index < m_polygons.size(); ++index)
+	{
+		const CPolygon& poly = *m_polygons[index];
+		if (!includeSleeping && !poly.IsAwake()) continue;
+
+		const AABB aabb = ComputePolygonAABB(poly);
+		AABB& oldAABB = m_aabbs[index];
+		if (aabb.minX != oldAABB.minX || aabb.minY != oldAABB.minY || aabb.maxX != oldAABB.maxX || aabb.maxY != oldAABB.maxY)
+		{
+			oldAABB = aabb;
+			moved = true;
+		}
+	}
+	return moved;
+}
+
+void CBroadPhaseGrid::BuildCells()
+{
+	/** Count pass : number of cells overlapped by every body gives the table size **/
+	size_t entryCount = 0;
+	for (const AABB& aabb : m_aabbs)
+	{
+		const size_t cellsX = (size_t)(GetCellCoord(aabb.maxX) - GetCellCoord(aabb.minX) + 1);
+		const size_t cellsY = (size_t)(GetCellCoord(aabb.maxY) - GetCellCoord(aabb.minY) + 1);
+		entryCount += cellsX * cellsY;
+	}
+
+	uint32_t bucketCount = 1;
+	while (bucketCount < 2 * entryCount) bucketCount <<= 1;
+	m_bucketMask = bucketCount - 1;
+
+	m_bucketStart.assign(bucketCount + 1, 0);
+	m_entries.resize(entryCount);
+
+	/** Histogram of bucket sizes, shifted by one so the prefix sum directly gives the bucket starts **/
+	for (const AABB& aabb : m_aabbs)
+	{
+		const int32_t maxX = GetCellCoord(aabb.maxX);
+		const int32_t maxY = GetCellCoord(aabb.maxY);
+
+		for (int32_t cellY = GetCellCoord(aabb.minY); cellY <= maxY; ++cellY)
+			for (int32_t cellX = GetCellCoord(aabb.minX); cellX <= maxX; ++cellX)
+				++m_bucketStart[GetBucket(cellX, cellY) + 1];
+	}
+
+	for (uint32_t bucket = 0; bucket < bucketCount; ++bucket)
+		m_bucketStart[bucket + 1] += m_bucketStart[bucket];
+
+	/** Scatter pass, bucketStart[b] is used as the write cursor and ends up as the start of bucket b + 1 **/
+	for (uint32_t proxy = 0; proxy < (uint32_t)m_aabbs.size(); ++proxy)
+	{
+		const AABB& aabb = m_aabbs[proxy];
+		const int32_t maxX = GetCellCoord(aabb.maxX);
+		const int32_t maxY = GetCellCoord(aabb.maxY);
+
+		for (int32_t cellY = GetCellCoord(aabb.minY); cellY <= maxY; ++cellY)
+		{
+			for (int32_t cellX = GetCellCoord(aabb.minX); cellX <= maxX; ++cellX)
+			{
+				uint32_t& cursor = m_bucketStart[GetBucket(cellX, cellY)];
+				m_entries[cursor++] = { cellX, cellY, proxy };
+			}
+		}
+	}
+
+	for (uint32_t bucket = bucketCount; bucket > 0; --bucket)
+		m_bucketStart[bucket] = m_bucketStart[bucket - 1];
+	m_bucketStart[0] = 0;
+}
+
+void CBroadPhaseGrid::FindPairs(std::vector<SPolygonPair>& pairsToCheck) const
+{
+	const uint32_t bucketCount = m_bucketMask + 1;
+
+	for (uint32_t bucket = 0; bucket < bucketCount; ++bucket)
+	{
+		const uint32_t end = m_bucketStart[bucket + 1];
+
+		for (uint32_t first = m_bucketStart[bucket]; first < end; ++first)
+		{
+			const SCellEntry& entryA = m_entries[first];
+			const AABB& aabbA = m_aabbs[entryA.proxy];
+			const CPolygonPtr& polyA = m_polygons[entryA.proxy];
+
+			for (uint32_t second = first + 1; second < end; ++second)
+			{
+				const SCellEntry& entryB = m_entries[second];
+
+				/** Buckets can mix cells through hash collisions **/
+				if (entryA.cellX != entryB.cellX || entryA.cellY != entryB.cellY) continue;
+
+				const AABB& aabbB = m_aabbs[entryB.proxy];
+				if (!aabbA.Collide(aabbB)) continue;
+
+				/** Bodies sharing several cells are only reported by the cell holding the min corner of their overlap **/
+				if (GetCellCoord(Max(aabbA.minX, aabbB.minX)) != entryA.cellX
+					|| GetCellCoord(Max(aabbA.minY, aabbB.minY)) != entryA.cellY)
+					continue;
+
+				const CPolygonPtr& polyB = m_polygons[entryB.proxy];
+				if (polyA->density == 0.0f && polyB->density == 0.0f) continue;
+
+				pairsToCheck.emplace_back(polyA, polyB);
+			}
+		}
+	}
+}
+
+int32_t CBroadPhaseGrid::GetCellCoord(float value) const
+{
+	return (int32_t)floorf(value * m_invCellSize);
+}
+
+uint32_t CBroadPhaseGrid::GetBucket(int32_t cellX, int32_t cellY) const
+{
+	return (((uint32_t)cellX * 73856093u) ^ ((uint32_t)cellY * 19349663u)) & m_bucketMask;
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <cstdint>
+#include "BroadPhase.h"
+#include "AABB.h"
+
+/** Uniform hashed grid, rebuilt by counting sort of the cell keys into one flat array on frames where an awake body moved **/
+class CBroadPhaseGrid : public IBroadPhase
+{
+public:
+	// cellSize <= 0 picks the largest dynamic body extent on Init
+	CBroadPhaseGrid(float cellSize = 0.0f);
+	~CBroadPhaseGrid() override;
+
+	void Init() override;
+	void GetCollidingPairsToCheck(std::vector<SPolygonPair>& pairsToCheck) override;
+	void DrawGizmos() override;
+
+	/** First query after a pair update rebuilds the cells, bodies are moved by the collision response in between **/
+	void QueryAABB(const AABB& aabb, const TQueryCallback& callback) override;
+	void RayCast(const SRayCastInput& input, const TRayCastCallback& callback) override;
+
+	void SetCellSize(float cellSize);
+	float GetCellSize() const;
+
+private:
+	struct SCellEntry
+	{
+		int32_t		cellX;
+		int32_t		cellY;
+		uint32_t	proxy;
+	};
+
+	// True if a box changed, sleeping bodies keep theirs unless includeSleeping
+	bool UpdateAABBs(bool includeSleeping);
+	void BuildCells();
+	void RefreshCells();
+	void FindPairs(std::vector<SPolygonPair>& pairsToCheck) const;
+	void BuildCellsIfNeeded();
+	bool RayCastCell(int32_t cellX, int32_t cellY, SRayCastInput& input, const TRayCastCallback& callback);
+
+	int32_t GetCellCoord(float value) const;
+	uint32_t GetBucket(int32_t cellX, int32_t cellY) const;
+
+	std::vector<CPolygonPtr>	m_polygons;
+	std::vector<AABB>			m_aabbs;
+
+	/** m_bucketStart[b] .. m_bucketStart[b + 1] is the range of bucket b in m_entries **/
+	std::vector<uint32_t>		m_bucketStart;
+	std::vector<SCellEntry>		m_entries;
+	uint32_t					m_bucketMask = 0;
+
+	/** Bodies already tested by the current ray, a body spans several cells **/
+	std::vector<uint32_t>		m_rayMarks;
+	uint32_t					m_rayMark = 0;
+	bool						m_queryCellsValid = false;
+
+	/** Cells match m_aabbs, pairs match the cells **/
+	bool						m_cellsValid = false;
+	bool						m_pairsValid = false;
+	std::vector<SPolygonPair>	m_pairs;
+
+	float						m_cellSize;
+	float						m_invCellSize;
+};
@@ -0,0 +1,278 @@
+#include "CBroadPhaseSAP.h"
+#include "GlobalVariables.h"
+#include "World.h"
+#include "Renderer.h"
+#include <string>
+#include <algorithm>
+
+CBroadPhaseSAP::CBroadPhaseSAP(bool useYAxis)
+	: m_useYAxis(useYAxis), m_axisCount(useYAxis ? 2 : 1)
+{
+}
+
+CBroadPhaseSAP::~CBroadPhaseSAP()
+{
+}
+
+void CBroadPhaseSAP::Init()
+{
+	const size_t polyCount = gVars->pWorld->GetPolygonCount();
+
+	m_proxies.reserve(polyCount);
+	for (size_t axis = 0; axis < m_axisCount; ++axis)
+		m_endPoints[axis].reserve(2 * polyCount);
+
+	for (size_t index = 0; index < polyCount; ++index)
+	{
+		AddProxy(gVars->pWorld->GetPolygon(index));
+	}
+
+	/** First sort is a full one, following frames only fix the few endpoints that moved **/
+	for (size_t axis = 0; axis < m_axisCount; ++axis)
+	{
+		std::vector<SEndPoint>& endPoints = m_endPoints[axis];
+		std::sort(endPoints.begin(), endPoints.end(), [this](const SEndPoint& a, const SEndPoint& b) { return IsBefore(a, b); });
+
+		for (uint32_t index = 0; index < endPoints.size(); ++index)
+			SetEndPointIndex(axis, index);
+	}
+
+	SweepInitialPairs();
+	ApplyPairEvents();
+}
+
+void CBroadPhaseSAP::GetCollidingPairsToCheck(std::vector<SPolygonPair>& pairsToCheck)
+{
+	if (m_proxies.empty()) Init();
+
+	m_beginCount = m_endCount = 0;
+
+	UpdateEndPoints();
+	for (size_t axis = 0; axis < m_axisCount; ++axis)
+		SortAxis(axis);
+	ApplyPairEvents();
+
+	for (const uint64_t key : m_pairs)
+	{
+		const SProxy& proxyA = m_proxies[(uint32_t)(key >> 32)];
+		const SProxy& proxyB = m_proxies[(uint32_t)(key & 0xFFFFFFFF)];
+
+		/** With a single sorted axis the pairs only tell about X overlap **/
+		if (!m_useYAxis && !proxyA.aabb.Collide(proxyB.aabb)) continue;
+
+		pairsToCheck.emplace_back(proxyA.poly, proxyB.poly);
+	}
+
+	if (gVars->bDebug && gVars->pPhysicEngine->IsDebugStep())
+	{
+		gVars->pRenderer->DisplayText("Potential Pairs : " + std::to_string(pairsToCheck.size()), 50, 150);
+		gVars->pRenderer->DisplayText("Overlaps begin : " + std::to_string(m_beginCount) + ", end : " + std::to_string(m_endCount), 50, 100);
+	}
+}
+
+void CBroadPhaseSAP::DrawGizmos()
+{
+	for (const SProxy& proxy : m_proxies)
+	{
+		Vec2 gizmosPoints[4];
+
+		gizmosPoints[0] = Vec2(proxy.aabb.minX, proxy.aabb.maxY);
+		gizmosPoints[1] = Vec2(proxy.aabb.maxX, proxy.aabb.maxY);
+		gizmosPoints[2] = Vec2(proxy.aabb.maxX, proxy.aabb.minY);
+		gizmosPoints[3] = Vec2(proxy.aabb.minX, proxy.aabb.minY);
+
+		const int gizmosMaxPoint = 4;
+
+		for (int index = 0; index < gizmosMaxPoint; ++index)
+			gVars->pRenderer->DrawLine(gizmosPoints[index], gizmosPoints[(index + 1) % gizmosMaxPoint], 0.f, 0.f, 1.f);
+	}
+}
+
+void CBroadPhaseSAP::AddProxy(const CPolygonPtr& poly)
+{
+	const uint32_t proxyIndex = (uint32_t)m_proxies.size();
+
+	SProxy proxy;
+	proxy.poly = poly;
+	proxy.aabb = ComputePolygonAABB(*poly);
+	m_proxies.push_back(proxy);
+
+	const float mins[2] = { proxy.aabb.minX, proxy.aabb.minY };
+	const float maxs[2] = { proxy.aabb.maxX, proxy.aabb.maxY };
+
+	for (size_t axis = 0; axis < m_axisCount; ++axis)
+	{
+		m_endPoints[axis].push_back({ mins[axis], proxyIndex << 1 });
+		m_endPoints[axis].push_back({ maxs[axis], (proxyIndex << 1) | 1 });
+	}
+}
+
+void CBroadPhaseSAP::UpdateEndPoints()
+{
+	for (SProxy& proxy : m_proxies)
+	{
+		if (!proxy.poly->IsAwake())
+			continue;
+
+		proxy.aabb = ComputePolygonAABB(*proxy.poly);
+
+		m_endPoints[0][proxy.minIndex[0]].value = proxy.aabb.minX;
+		m_endPoints[0][proxy.maxIndex[0]].value = proxy.aabb.maxX;
+
+		if (m_useYAxis)
+		{
+			m_endPoints[1][proxy.minIndex[1]].value = proxy.aabb.minY;
+			m_endPoints[1][proxy.maxIndex[1]].value = proxy.aabb.maxY;
+		}
+	}
+}
+
+void CBroadPhaseSAP::SortAxis(size_t axis)
+{
+	std::vector<SEndPoint>& endPoints = m_endPoints[axis];
+	const uint32_t count = (uint32_t)endPoints.size();
+
+	for (uint32_t index = 1; index < count; ++index)
+	{
+		const SEndPoint key = endPoints[index];
+		uint32_t slot = index;
+
+		/** Every swap is an overlap event : a min passing a max starts one, a max passing a min ends one **/
+		while (slot > 0 && IsBefore(key, endPoints[slot - 1]))
+		{
+			const SEndPoint& other = endPoints[slot - 1];
+
+			if (!key.IsMax() && other.IsMax())
+				BeginOverlap(key.GetProxy(), other.GetProxy());
+			else if (key.IsMax() && !other.IsMax())
+				EndOverlap(key.GetProxy(), other.GetProxy());
+
+			endPoints[slot] = other;
+			SetEndPointIndex(axis, slot);
+			--slot;
+		}
+
+		if (slot != index)
+		{
+			endPoints[slot] = key;
+			SetEndPointIndex(axis, slot);
+		}
+	}
+}
+
+void CBroadPhaseSAP::SweepInitialPairs()
+{
+	m_pairs.clear();
+	m_pairEvents.clear();
+	m_activeProxies.clear();
+
+	for (const SEndPoint& endPoint : m_endPoints[0])
+	{
+		const uint32_t proxy = endPoint.GetProxy();
+
+		if (endPoint.IsMax())
+		{
+			m_activeProxies.erase(std::find(m_activeProxies.begin(), m_activeProxies.end(), proxy));
+			continue;
+		}
+
+		for (uint32_t activeProxy : m_activeProxies)
+			BeginOverlap(proxy, activeProxy);
+
+		m_activeProxies.push_back(proxy);
+	}
+}
+
+bool CBroadPhaseSAP::IsBefore(const SEndPoint& a, const SEndPoint& b) const
+{
+	/** On equal values mins go first, so touching boxes count as overlapping like AABB::Collide **/
+	return a.value < b.value || (a.value == b.value && !a.IsMax() && b.IsMax());
+}
+
+void CBroadPhaseSAP::SetEndPointIndex(size_t axis, uint32_t index)
+{
+	const SEndPoint& endPoint = m_endPoints[axis][index];
+	SProxy& proxy = m_proxies[endPoint.GetProxy()];
+
+	if (endPoint.IsMax())
+		proxy.maxIndex[axis] = index;
+	else
+		proxy.minIndex[axis] = index;
+}
+
+void CBroadPhaseSAP::BeginOverlap(uint32_t proxyA, uint32_t proxyB)
+{
+	const SProxy& first = m_proxies[proxyA];
+	const SProxy& second = m_proxies[proxyB];
+
+	if (first.poly->density == 0.0f && second.poly->density == 0.0f)
+		return;
+
+	/** The swap only proves overlap on the sorted axis, the other one must agree too **/
+	if (m_useYAxis && !first.aabb.Collide(second.aabb))
+		return;
+
+	m_pairEvents.push_back({ GetPairKey(proxyA, proxyB), (uint32_t)m_pairEvents.size(), true });
+}
+
+void CBroadPhaseSAP::EndOverlap(uint32_t proxyA, uint32_t proxyB)
+{
+	m_pairEvents.push_back({ GetPairKey(proxyA, proxyB), (uint32_t)m_pairEvents.size(), false });
+}
+
+void CBroadPhaseSAP::ApplyPairEvents()
+{
+	/** A key can begin and end several times in one sort, only its last event against the previous pairs matters **/
+	std::sort(m_pairEvents.begin(), m_pairEvents.end(), [](const SPairEvent& a, const SPairEvent& b)
+	{
+		return a.key < b.key || (a.key == b.key && a.order < b.order);
+	});
+
+	m_addedPairs.clear();
+	m_removedPairs.clear();
+	for (size_t index = 0; index < m_pairEvents.size(); ++index)
+	{
+		const SPairEvent& pairEvent = m_pairEvents[index];
+		if (index + 1 < m_pairEvents.size() && m_pairEvents[index + 1].key == pairEvent.key)
+			continue;
+
+		const bool wasOverlapping = std::binary_search(m_pairs.begin(), m_pairs.end(), pairEvent.key);
+		if (pairEvent.begin && !wasOverlapping)
+			m_addedPairs.push_back(pairEvent.key);
+		else if (!pairEvent.begin && wasOverlapping)
+			m_removedPairs.push_back(pairEvent.key);
+	}
+	m_pairEvents.clear();
+
+	m_beginCount = m_addedPairs.size();
+	m_endCount = m_removedPairs.size();
+	if (m_addedPairs.empty() && m_removedPairs.empty())
+		return;
+
+	/** Both lists are sorted and the removed keys are all in m_pairs, one merge pass **/
+	m_mergedPairs.clear();
+	size_t added = 0;
+	size_t removed = 0;
+	for (const uint64_t key : m_pairs)
+	{
+		while (added < m_addedPairs.size() && m_addedPairs[added] < key)
+			m_mergedPairs.push_back(m_addedPairs[added++]);
+
+		if (removed < m_removedPairs.size() && m_removedPairs[removed] == key)
+		{
+			++removed;
+			continue;
+		}
+		m_mergedPairs.push_back(key);
+	}
+	m_mergedPairs.insert(m_mergedPairs.end(), m_addedPairs.begin() + added, m_addedPairs.end());
+
+	m_pairs.swap(m_mergedPairs);
+}
+
+uint64_t CBroadPhaseSAP::GetPairKey(uint32_t proxyA, uint32_t proxyB) const
+{
+	const uint64_t minProxy = Min(proxyA, proxyB);
+	const uint64_t maxProxy = Max(proxyA, proxyB);
+	return (minProxy << 32) | maxProxy;
+}
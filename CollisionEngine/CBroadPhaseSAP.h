@@ -0,0 +1,69 @@
+#pragma once
+#include <cstdint>
+#include "BroadPhase.h"
+#include "AABB.h"
+
+/** Sweep and prune on persistent sorted endpoint lists, kept sorted by insertion sort to exploit frame to frame coherence **/
+class CBroadPhaseSAP : public IBroadPhase
+{
+public:
+	CBroadPhaseSAP(bool useYAxis = true);
+	~CBroadPhaseSAP() override;
+
+	void Init() override;
+	void GetCollidingPairsToCheck(std::vector<SPolygonPair>& pairsToCheck) override;
+	void DrawGizmos() override;
+
+private:
+	struct SEndPoint
+	{
+		float		value;
+		uint32_t	data; // proxy index << 1 | 1 if max endpoint
+
+		uint32_t	GetProxy() const { return data >> 1; }
+		bool		IsMax() const { return (data & 1) != 0; }
+	};
+
+	/** Overlap begin / end found by the sort, applied to m_pairs once the sort is done **/
+	struct SPairEvent
+	{
+		uint64_t	key;
+		uint32_t	order;	// last event of a key wins
+		bool		begin;
+	};
+
+	struct SProxy
+	{
+		CPolygonPtr	poly;
+		AABB		aabb;
+		uint32_t	minIndex[2];
+		uint32_t	maxIndex[2];
+	};
+
+	void AddProxy(const CPolygonPtr& poly);
+	void UpdateEndPoints();
+	void SortAxis(size_t axis);
+	void SweepInitialPairs();
+
+	bool IsBefore(const SEndPoint& a, const SEndPoint& b) const;
+	void SetEndPointIndex(size_t axis, uint32_t index);
+	void BeginOverlap(uint32_t proxyA, uint32_t proxyB);
+	void EndOverlap(uint32_t proxyA, uint32_t proxyB);
+	uint64_t GetPairKey(uint32_t proxyA, uint32_t proxyB) const;
+	void ApplyPairEvents();
+
+	std::vector<SProxy>				m_proxies;
+	std::vector<SEndPoint>			m_endPoints[2];
+	/** Sorted (proxyA << 32 | proxyB) keys, proxyA < proxyB, so pairs come out in the same order whatever the event history **/
+	std::vector<uint64_t>			m_pairs;
+	std::vector<SPairEvent>			m_pairEvents;
+	std::vector<uint64_t>			m_addedPairs;
+	std::vector<uint64_t>			m_removedPairs;
+	std::vector<uint64_t>			m_mergedPairs;
+	std::vector<uint32_t>			m_activeProxies;
+
+	const bool						m_useYAxis;
+	size_t							m_axisCount;
+	size_t							m_beginCount = 0;
+	size_t							m_endCount = 0;
+};
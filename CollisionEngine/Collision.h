@@ -11,6 +11,51 @@ struct SPolygonPair
 	CPolygonPtr	polyB;
 };
 
+/** Segment from -> to, only the [0, maxFraction] part of it is tested **/
+struct SRayCastInput
+{
+	SRayCastInput(const Vec2& _from, const Vec2& _to, float _maxFraction = 1.0f) : from(_from), to(_to), maxFraction(_maxFraction){}
+
+	Vec2	from;
+	Vec2	to;
+	float	maxFraction;
+};
+
+struct SRayCastHit
+{
+	CPolygonPtr	poly;
+	Vec2		point;
+	Vec2		normal;
+	float		fraction = 1.0f;
+};
+
+/** Last SAT result of a pair : edge (of polygon ownerIndex) that separated them, or that gave the smallest overlap **/
+struct SSatCache
+{
+	size_t		ownerIndex = SIZE_MAX;
+	size_t		edge = 0;
+	bool		separated = false;
+	uint32_t	lastFrame = 0;
+};
+
+/** Contact feature ids : the edge or vertex of A and of B that made a manifold point, stable while the pair keeps touching the same way **/
+enum class ContactFeatureType : size_t
+{
+	Vertex = 0,
+	Edge,
+};
+
+inline size_t	MakeContactFeature(size_t indexA, ContactFeatureType typeA, size_t indexB, ContactFeatureType typeB)
+{
+	return (indexA << 17) | ((size_t)typeA << 16) | (indexB << 1) | (size_t)typeB;
+}
+
+/** Same feature seen from B / A **/
+inline size_t	FlipContactFeature(size_t feature)
+{
+	return ((feature & 0xFFFF) << 16) | (feature >> 16);
+}
+
 struct SContactInfo
 {
 	SContactInfo() = default;
@@ -38,7 +83,11 @@ struct SContactInfo
 	Vec2	edgeNormalA;
 	Vec2	edgeNormalB;
 
-	size_t	index;
+	size_t	index;	// contact feature, see MakeContactFeature
+
+	// Accumulated impulses, loaded from the contact cache when the feature was already touching last step
+	float	normalImpulse = 0.0f;
+	float	tangentImpulse = 0.0f;
 };
 
 struct SContact
@@ -0,0 +1,200 @@
+#include "ContactCache.h"
+
+#include "Collision.h"
+
+namespace
+{
+	const size_t INITIAL_CAPACITY = 64;
+
+	/** 64 bits finalizer from MurmurHash3 **/
+	inline uint64_t	HashKey(uint64_t key)
+	{
+		key ^= key >> 33;
+		key *= 0xff51afd7ed558ccdULL;
+		key ^= key >> 33;
+		key *= 0xc4ceb9fe1a85ec53ULL;
+		key ^= key >> 33;
+		return key;
+	}
+}
+
+CContactCache::CContactCache()
+{
+	m_entries.resize(INITIAL_CAPACITY);
+}
+
+void	CContactCache::Clear()
+{
+	m_entries.clear();
+	m_entries.resize(INITIAL_CAPACITY);
+	m_count = 0;
+	m_liveKeys.clear();
+	m_previousKeys.clear();
+}
+
+size_t	CContactCache::GetPairCount() const
+{
+	return m_count;
+}
+
+uint64_t	CContactCache::GetKey(const SCollision& collision, bool& flipped)
+{
+	const uint64_t indexA = collision.polyA->GetIndex();
+	const uint64_t indexB = collision.polyB->GetIndex();
+	flipped = indexA > indexB;
+	return (Min(indexA, indexB) << 32) | Max(indexA, indexB);
+}
+
+size_t	CContactCache::GetSlot(uint64_t key) const
+{
+	return (size_t)HashKey(key) & (m_entries.size() - 1);
+}
+
+CContactCache::SPairEntry*	CContactCache::Find(uint64_t key)
+{
+	for (size_t slot = GetSlot(key);; slot = (slot + 1) & (m_entries.size() - 1))
+	{
+		if (m_entries[slot].key == key) return &m_entries[slot];
+		if (m_entries[slot].key == EmptyKey) return nullptr;
+	}
+}
+
+CContactCache::SPairEntry&	CContactCache::FindOrInsert(uint64_t key, bool& inserted)
+{
+	if ((m_count + 1) * 2 > m_entries.size())
+		Grow();
+
+	size_t slot = GetSlot(key);
+	while (m_entries[slot].key != key && m_entries[slot].key != EmptyKey)
+		slot = (slot + 1) & (m_entries.size() - 1);
+
+	inserted = (m_entries[slot].key == EmptyKey);
+	if (inserted)
+	{
+		m_entries[slot].key = key;
+		m_entries[slot].contactCount = 0;
+		++m_count;
+	}
+	return m_entries[slot];
+}
+
+void	CContactCache::Remove(size_t slot)
+{
+	/** Backward shift : pull the following entries of the probe chain into the hole, no tombstones **/
+	const size_t mask = m_entries.size() - 1;
+	size_t hole = slot;
+	for (size_t next = (hole + 1) & mask; m_entries[next].key != EmptyKey; next = (next + 1) & mask)
+	{
+		const size_t home = GetSlot(m_entries[next].key);
+
+		/** Entry can fill the hole if its home slot is not in (hole, next] **/
+		const bool canMove = (hole <= next) ? (home <= hole || home > next) : (home <= hole && home > next);
+		if (canMove)
+		{
+			m_entries[hole] = std::move(m_entries[next]);
+			hole = next;
+		}
+	}
+
+	m_entries[hole] = SPairEntry();
+	--m_count;
+}
+
+void	CContactCache::Grow()
+{
+	std::vector<SPairEntry> oldEntries(m_entries.size() * 2);
+	oldEntries.swap(m_entries);
+
+	for (SPairEntry& entry : oldEntries)
+	{
+		if (entry.key == EmptyKey) continue;
+
+		size_t slot = GetSlot(entry.key);
+		while (m_entries[slot].key != EmptyKey)
+			slot = (slot + 1) & (m_entries.size() - 1);
+		m_entries[slot] = std::move(entry);
+	}
+}
+
+void	CContactCache::StoreImpulses(const std::vector<SCollision>& collisions)
+{
+	for (const SCollision& collision : collisions)
+	{
+		bool flipped;
+		SPairEntry* entry = Find(GetKey(collision, flipped));
+		if (entry == nullptr) continue;
+
+		entry->contactCount = collision.manifoldSize;
+		for (size_t index = 0; index < collision.manifoldSize; ++index)
+		{
+			const SContactInfo& contact = collision.manifold[index];
+			entry->contacts[index].feature = flipped ? FlipContactFeature(contact.index) : contact.index;
+			entry->contacts[index].normalImpulse = contact.normalImpulse;
+			entry->contacts[index].tangentImpulse = contact.tangentImpulse;
+		}
+	}
+}
+
+void	CContactCache::Update(std::vector<SCollision>& collisions, std::vector<SContactEvent>& events)
+{
+	++m_step;
+
+	m_previousKeys.swap(m_liveKeys);
+	m_liveKeys.clear();
+
+	for (SCollision& collision : collisions)
+	{
+		bool flipped, inserted;
+		const uint64_t key = GetKey(collision, flipped);
+		SPairEntry& entry = FindOrInsert(key, inserted);
+		m_liveKeys.push_back(key);
+
+		/** Index reused by another polygon since the last step : that is a new pair **/
+		CPolygonPtr& polyA = flipped ? collision.polyB : collision.polyA;
+		CPolygonPtr& polyB = flipped ? collision.polyA : collision.polyB;
+		if (!inserted && (entry.polyA != polyA || entry.polyB != polyB))
+		{
+			events.push_back({ ContactEventType::End, entry.polyA, entry.polyB, nullptr });
+			entry.contactCount = 0;
+			inserted = true;
+		}
+
+		if (inserted)
+		{
+			entry.polyA = polyA;
+			entry.polyB = polyB;
+		}
+		entry.lastStep = m_step;
+
+		/** Warm start the features that were already touching **/
+		for (size_t index = 0; index < collision.manifoldSize; ++index)
+		{
+			SContactInfo& contact = collision.manifold[index];
+			const size_t feature = flipped ? FlipContactFeature(contact.index) : contact.index;
+
+			contact.normalImpulse = 0.0f;
+			contact.tangentImpulse = 0.0f;
+			for (size_t cached = 0; cached < entry.contactCount; ++cached)
+			{
+				if (entry.contacts[cached].feature != feature) continue;
+
+				contact.normalImpulse = entry.contacts[cached].normalImpulse;
+				contact.tangentImpulse = entry.contacts[cached].tangentImpulse;
+				break;
+			}
+		}
+
+		events.push_back({ inserted ? ContactEventType::Begin : ContactEventType::Persist, collision.polyA, collision.polyB, &collision });
+	}
+
+	/** Pairs of the last step not seen in this one stopped touching, only those are looked up : the cost follows
+	the touching pairs, not the capacity the table grew to **/
+	for (uint64_t key : m_previousKeys)
+	{
+		SPairEntry* entry = Find(key);
+		if (entry == nullptr || entry->lastStep == m_step) continue;
+
+		events.push_back({ ContactEventType::End, entry->polyA, entry->polyB, nullptr });
+		Remove(entry - m_entries.data());
+	}
+}
@@ -0,0 +1,80 @@
+#ifndef _CONTACT_CACHE_H_
+#define _CONTACT_CACHE_H_
+
+#include <vector>
+#include <cstdint>
+#include "Polygon.h"
+
+struct SCollision;
+
+enum class ContactEventType : int
+{
+	Begin = 0,	// pair touching this step and not the previous one
+	Persist,
+	End,		// pair touching the previous step and not this one
+
+	Count,
+};
+
+struct SContactEvent
+{
+	ContactEventType	type;
+	CPolygonPtr			polyA;
+	CPolygonPtr			polyB;
+	const SCollision*	collision = nullptr; // nullptr for End
+};
+
+/** Touching pairs of the last step, open addressing on (min index, max index) with linear probing.
+Keeps the accumulated impulses of every manifold point by feature id to warm start the next solve. **/
+class CContactCache
+{
+public:
+	CContactCache();
+
+	void	Clear();
+
+	// Saves the impulses the solver left in the manifolds of the last step
+	void	StoreImpulses(const std::vector<SCollision>& collisions);
+
+	// Loads the saved impulses of matching features into the new manifolds, removes the pairs that stopped touching.
+	// Events are appended in collision order, then End events
+	void	Update(std::vector<SCollision>& collisions, std::vector<SContactEvent>& events);
+
+	size_t	GetPairCount() const;
+
+private:
+	struct SCachedContact
+	{
+		size_t	feature;	// seen from the polygon with the smaller index
+		float	normalImpulse;
+		float	tangentImpulse;
+	};
+
+	struct SPairEntry
+	{
+		uint64_t		key = EmptyKey;
+		CPolygonPtr		polyA;		// smaller index
+		CPolygonPtr		polyB;
+		uint32_t		lastStep = 0;
+		size_t			contactCount = 0;
+		SCachedContact	contacts[2];
+	};
+
+	static const uint64_t	EmptyKey = UINT64_MAX;
+
+	static uint64_t	GetKey(const SCollision& collision, bool& flipped);
+	size_t			GetSlot(uint64_t key) const;
+
+	SPairEntry*		Find(uint64_t key);
+	SPairEntry&		FindOrInsert(uint64_t key, bool& inserted);
+	void			Remove(size_t slot);
+	void			Grow();
+
+	std::vector<SPairEntry>	m_entries;	// power of 2 size, at most half full
+	size_t					m_count = 0;
+	uint32_t				m_step = 0;
+	std::vector<uint64_t>	m_liveKeys;		// pairs touching in the last Update, in collision order
+	std::vector<uint64_t>	m_previousKeys;
+};
+
+#endif
@@ -0,0 +1,428 @@
+#include "ContactSolver.h"
+
+#include <mutex>
+
+#include "GlobalVariables.h"
+#include "ThreadPool.h"
+#include "Polygon.h"
+#include "Collision.h"
+
+CContactSolver::SBody	CContactSolver::MakeBody(CPolygon& poly)
+{
+	SBody body;
+	body.poly = &poly;
+
+	/** Sleeping bodies stay where they are, like statics **/
+	if (!poly.IsAwake())
+	{
+		body.invMass = 0.0f;
+		body.invInertia = 0.0f;
+		return body;
+	}
+
+	const float mass = poly.GetMass();
+	const float inertia = poly.GetInertiaTensor();
+	body.invMass = (mass > 0.0f) ? 1.0f / mass : 0.0f;
+	body.invInertia = (inertia > 0.0f) ? 1.0f / inertia : 0.0f;
+	return body;
+}
+
+bool	CContactSolver::IsDynamic(const SBody& body)
+{
+	return body.invMass > 0.0f || body.invInertia > 0.0f;
+}
+
+void	CContactSolver::Init(std::vector<SCollision>& collisions, const SSolverSettings& settings)
+{
+	m_settings = settings;
+	m_constraints.clear();
+	m_constraints.reserve(collisions.size());
+
+	for (SCollision& collision : collisions)
+	{
+		SContactConstraint constraint;
+		constraint.collision = &collision;
+		constraint.bodyA = MakeBody(*collision.polyA);
+		constraint.bodyB = MakeBody(*collision.polyB);
+
+		/** Two static bodies (or kinematic ones moved by hand) have nothing to solve **/
+		if (constraint.bodyA.invMass == 0.0f && constraint.bodyB.invMass == 0.0f)
+			continue;
+
+		constraint.normal = collision.normal;
+		constraint.tangent = Vec2(collision.normal.y, -collision.normal.x);
+		constraint.friction = m_settings.friction;
+		constraint.pointCount = collision.manifoldSize;
+
+		const CPolygon& polyA = *collision.polyA;
+		const CPolygon& polyB = *collision.polyB;
+
+		for (size_t index = 0; index < collision.manifoldSize; ++index)
+		{
+			const SContactInfo& contact = collision.manifold[index];
+			SContactPoint& point = constraint.points[index];
+
+			point.rA = contact.point - polyA.position;
+			point.rB = contact.point - polyB.position;
+
+			/** Contact point is half way between both surfaces along the normal **/
+			point.localAnchorA = polyA.InverseTransformPoint(contact.point + constraint.normal * (0.5f * contact.penetration));
+			point.localAnchorB = polyB.InverseTransformPoint(contact.point - constraint.normal * (0.5f * contact.penetration));
+
+			point.normalImpulse = m_settings.warmStarting ? contact.normalImpulse : 0.0f;
+			point.tangentImpulse = m_settings.warmStarting ? contact.tangentImpulse : 0.0f;
+
+			/** Effective masses along the normal and the tangent **/
+			const float rnA = point.rA ^ constraint.normal;
+			const float rnB = point.rB ^ constraint.normal;
+			const float normalK = constraint.bodyA.invMass + constraint.bodyB.invMass + constraint.bodyA.invInertia * rnA * rnA + constraint.bodyB.invInertia * rnB * rnB;
+			point.normalMass = (normalK > 0.0f) ? 1.0f / normalK : 0.0f;
+
+			const float rtA = point.rA ^ constraint.tangent;
+			const float rtB = point.rB ^ constraint.tangent;
+			const float tangentK = constraint.bodyA.invMass + constraint.bodyB.invMass + constraint.bodyA.invInertia * rtA * rtA + constraint.bodyB.invInertia * rtB * rtB;
+			point.tangentMass = (tangentK > 0.0f) ? 1.0f / tangentK : 0.0f;
+
+			/** Restitution from the approach speed before solving **/
+			const Vec2 relativeVelocity = polyB.GetPointVelocity(contact.point) - polyA.GetPointVelocity(contact.point);
+			const float normalVelocity = relativeVelocity | constraint.normal;
+			point.velocityBias = (normalVelocity < -m_settings.restitutionThreshold) ? -m_settings.restitution * normalVelocity : 0.0f;
+		}
+
+		/** Block solve only while K stays well conditioned, nearly redundant points (tiny or aligned rA / rB) go sequential **/
+		constraint.blockSolve = false;
+		if (m_settings.blockSolver && constraint.pointCount == 2)
+		{
+			const SBody& bodyA = constraint.bodyA;
+			const SBody& bodyB = constraint.bodyB;
+			const SContactPoint& point1 = constraint.points[0];
+			const SContactPoint& point2 = constraint.points[1];
+
+			const float rn1A = point1.rA ^ constraint.normal;
+			const float rn1B = point1.rB ^ constraint.normal;
+			const float rn2A = point2.rA ^ constraint.normal;
+			const float rn2B = point2.rB ^ constraint.normal;
+
+			const float invMass = bodyA.invMass + bodyB.invMass;
+			const float k11 = invMass + bodyA.invInertia * rn1A * rn1A + bodyB.invInertia * rn1B * rn1B;
+			const float k22 = invMass + bodyA.invInertia * rn2A * rn2A + bodyB.invInertia * rn2B * rn2B;
+			const float k12 = invMass + bodyA.invInertia * rn1A * rn2A + bodyB.invInertia * rn1B * rn2B;
+
+			const float maxConditionNumber = 1000.0f;
+			if (k11 * k11 < maxConditionNumber * (k11 * k22 - k12 * k12))
+			{
+				constraint.K = Mat2(k11, k12, k12, k22);
+				constraint.invK = constraint.K.GetInverse();
+				constraint.blockSolve = true;
+			}
+		}
+
+		m_constraints.push_back(constraint);
+	}
+
+	BuildColors();
+}
+
+void	CContactSolver::BuildColors()
+{
+	/** Greedy, each constraint takes the first color its dynamic bodies don't use yet.
+	Statics never take a color : they are only read, so the ground can touch every constraint of a color **/
+	m_colors.clear();
+	m_overflowBegin = 0;
+
+	/** Colors solve a stack red black instead of bottom up and converge slower, single threaded or small solves keep the detection order **/
+	CThreadPool* threadPool = gVars->pThreadPool;
+	if (!threadPool || threadPool->GetThreadCount() <= 1 || m_constraints.size() < m_parallelColorThreshold)
+	{
+		return;
+	}
+
+	size_t bodyCount = 0;
+	for (const SContactConstraint& constraint : m_constraints)
+	{
+		bodyCount = Max(bodyCount, Max(constraint.bodyA.poly->GetIndex(), constraint.bodyB.poly->GetIndex()) + 1);
+	}
+
+	m_bodyColors.assign(bodyCount, 0);
+	m_constraintColors.resize(m_constraints.size());
+
+	size_t colorSizes[m_maxColors + 1] = {};
+	for (size_t index = 0; index < m_constraints.size(); ++index)
+	{
+		const SContactConstraint& constraint = m_constraints[index];
+		const bool dynamicA = IsDynamic(constraint.bodyA);
+		const bool dynamicB = IsDynamic(constraint.bodyB);
+		const size_t indexA = constraint.bodyA.poly->GetIndex();
+		const size_t indexB = constraint.bodyB.poly->GetIndex();
+
+		const uint64_t usedColors = (dynamicA ? m_bodyColors[indexA] : 0) | (dynamicB ? m_bodyColors[indexB] : 0);
+
+		size_t color = 0;
+		while (color < m_maxColors && (usedColors & (1ull << color)))
+		{
+			++color;
+		}
+
+		if (color < m_maxColors)
+		{
+			if (dynamicA) m_bodyColors[indexA] |= (1ull << color);
+			if (dynamicB) m_bodyColors[indexB] |= (1ull << color);
+		}
+
+		m_constraintColors[index] = color;
+		++colorSizes[color];
+	}
+
+	/** Counting sort keeps the detection order inside a color, results don't depend on the thread count **/
+	size_t colorBegins[m_maxColors + 1];
+	size_t begin = 0;
+	for (size_t color = 0; color <= m_maxColors; ++color)
+	{
+		colorBegins[color] = begin;
+		if (color < m_maxColors && colorSizes[color] > 0)
+		{
+			m_colors.push_back({ begin, begin + colorSizes[color] });
+		}
+		begin += colorSizes[color];
+	}
+	m_overflowBegin = colorBegins[m_maxColors];
+
+	m_sortedConstraints.resize(m_constraints.size());
+	for (size_t index = 0; index < m_constraints.size(); ++index)
+	{
+		m_sortedConstraints[colorBegins[m_constraintColors[index]]++] = m_constraints[index];
+	}
+	m_constraints.swap(m_sortedConstraints);
+}
+
+size_t	CContactSolver::GetColorCount() const
+{
+	return m_colors.size();
+}
+
+void	CContactSolver::ForEachColor(const std::function<void(size_t, size_t)>& solveRange)
+{
+	CThreadPool* threadPool = gVars->pThreadPool;
+
+	for (const SColor& color : m_colors)
+	{
+		const size_t count = color.end - color.begin;
+		if (count < m_parallelColorThreshold)
+		{
+			solveRange(color.begin, color.end);
+			continue;
+		}
+
+		/** The next color needs this one's velocities, ParallelFor returning is the barrier **/
+		const size_t taskCount = (count + m_taskSize - 1) / m_taskSize;
+		threadPool->ParallelFor(taskCount, [&](size_t task)
+		{
+			const size_t begin = color.begin + task * m_taskSize;
+			solveRange(begin, Min(begin + m_taskSize, color.end));
+		});
+	}
+
+	solveRange(m_overflowBegin, m_constraints.size());
+}
+
+void	CContactSolver::ApplyImpulse(SContactConstraint& constraint, const SContactPoint& point, const Vec2& impulse)
+{
+	/** Statics are shared by constraints solved in parallel, never write them **/
+	if (IsDynamic(constraint.bodyA))
+	{
+		CPolygon& polyA = *constraint.bodyA.poly;
+		polyA.speed -= impulse * constraint.bodyA.invMass;
+		polyA.angularVelocity -= constraint.bodyA.invInertia * (point.rA ^ impulse);
+	}
+
+	if (IsDynamic(constraint.bodyB))
+	{
+		CPolygon& polyB = *constraint.bodyB.poly;
+		polyB.speed += impulse * constraint.bodyB.invMass;
+		polyB.angularVelocity += constraint.bodyB.invInertia * (point.rB ^ impulse);
+	}
+}
+
+void	CContactSolver::WarmStart()
+{
+	ForEachColor([&](size_t begin, size_t end)
+	{
+		for (size_t constraintIndex = begin; constraintIndex < end; ++constraintIndex)
+		{
+			SContactConstraint& constraint = m_constraints[constraintIndex];
+			for (size_t index = 0; index < constraint.pointCount; ++index)
+			{
+				const SContactPoint& point = constraint.points[index];
+				ApplyImpulse(constraint, point, constraint.normal * point.normalImpulse + constraint.tangent * point.tangentImpulse);
+			}
+		}
+	});
+}
+
+void	CContactSolver::SolveVelocityConstraints()
+{
+	ForEachColor([&](size_t begin, size_t end)
+	{
+		for (size_t index = begin; index < end; ++index)
+		{
+			SolveVelocityConstraint(m_constraints[index]);
+		}
+	});
+}
+
+void	CContactSolver::SolveVelocityConstraint(SContactConstraint& constraint)
+{
+	const CPolygon& polyA = *constraint.bodyA.poly;
+	const CPolygon& polyB = *constraint.bodyB.poly;
+
+	/** Friction first, bounded by the current normal impulse **/
+	for (size_t index = 0; index < constraint.pointCount; ++index)
+	{
+		SContactPoint& point = constraint.points[index];
+
+		const Vec2 relativeVelocity = (polyB.speed + point.rB.GetNormal() * polyB.angularVelocity) - (polyA.speed + point.rA.GetNormal() * polyA.angularVelocity);
+		const float lambda = -point.tangentMass * (relativeVelocity | constraint.tangent);
+
+		const float maxFriction = constraint.friction * point.normalImpulse;
+		const float newImpulse = Clamp(point.tangentImpulse + lambda, -maxFriction, maxFriction);
+		const float delta = newImpulse - point.tangentImpulse;
+		point.tangentImpulse = newImpulse;
+
+		ApplyImpulse(constraint, point, constraint.tangent * delta);
+	}
+
+	/** Non penetration, the accumulated impulse can only push **/
+	if (!constraint.blockSolve || !SolveNormalBlock(constraint))
+	{
+		SolveNormalSequential(constraint);
+	}
+}
+
+float	CContactSolver::GetNormalVelocity(const SContactConstraint& constraint, const SContactPoint& point)
+{
+	const CPolygon& polyA = *constraint.bodyA.poly;
+	const CPolygon& polyB = *constraint.bodyB.poly;
+
+	const Vec2 relativeVelocity = (polyB.speed + point.rB.GetNormal() * polyB.angularVelocity) - (polyA.speed + point.rA.GetNormal() * polyA.angularVelocity);
+	return relativeVelocity | constraint.normal;
+}
+
+void	CContactSolver::SolveNormalSequential(SContactConstraint& constraint)
+{
+	for (size_t index = 0; index < constraint.pointCount; ++index)
+	{
+		SContactPoint& point = constraint.points[index];
+
+		const float lambda = -point.normalMass * (GetNormalVelocity(constraint, point) - point.velocityBias);
+
+		const float newImpulse = Max(point.normalImpulse + lambda, 0.0f);
+		const float delta = newImpulse - point.normalImpulse;
+		point.normalImpulse = newImpulse;
+
+		ApplyImpulse(constraint, point, constraint.normal * delta);
+	}
+}
+
+bool	CContactSolver::SolveNormalBlock(SContactConstraint& constraint)
+{
+	SContactPoint& point1 = constraint.points[0];
+	SContactPoint& point2 = constraint.points[1];
+
+	/** With a the current accumulated impulses, new ones x must give vn = K * (x - a) + vn_current >= bias, see Solve2DLCP **/
+	const Vec2 accumulated(point1.normalImpulse, point2.normalImpulse);
+	const Vec2 normalVelocity(GetNormalVelocity(constraint, point1) - point1.velocityBias, GetNormalVelocity(constraint, point2) - point2.velocityBias);
+	const Vec2 b = normalVelocity - constraint.K * accumulated;
+
+	Vec2 impulses;
+	if (!Solve2DLCP(constraint.K, constraint.invK, b, impulses))
+		return false;
+
+	const Vec2 delta = impulses - accumulated;
+	ApplyImpulse(constraint, point1, constraint.normal * delta.x);
+	ApplyImpulse(constraint, point2, constraint.normal * delta.y);
+
+	point1.normalImpulse = impulses.x;
+	point2.normalImpulse = impulses.y;
+	return true;
+}
+
+void	CContactSolver::StoreImpulses()
+{
+	for (SContactConstraint& constraint : m_constraints)
+	{
+		for (size_t index = 0; index < constraint.pointCount; ++index)
+		{
+			constraint.collision->manifold[index].normalImpulse = constraint.points[index].normalImpulse;
+			constraint.collision->manifold[index].tangentImpulse = constraint.points[index].tangentImpulse;
+		}
+	}
+}
+
+bool	CContactSolver::SolvePositionConstraints()
+{
+	float minSeparation = 0.0f;
+	std::mutex separationMutex;
+
+	ForEachColor([&](size_t begin, size_t end)
+	{
+		float rangeSeparation = 0.0f;
+		for (size_t index = begin; index < end; ++index)
+		{
+			rangeSeparation = Min(rangeSeparation, SolvePositionConstraint(m_constraints[index]));
+		}
+
+		std::lock_guard<std::mutex> lock(separationMutex);
+		minSeparation = Min(minSeparation, rangeSeparation);
+	});
+
+	/** Corrections stop at linearSlop, so a little more than that is converged **/
+	return minSeparation >= -3.0f * m_settings.linearSlop;
+}
+
+float	CContactSolver::SolvePositionConstraint(SContactConstraint& constraint)
+{
+	float minSeparation = 0.0f;
+
+	CPolygon& polyA = *constraint.bodyA.poly;
+	CPolygon& polyB = *constraint.bodyB.poly;
+	const bool dynamicA = IsDynamic(constraint.bodyA);
+	const bool dynamicB = IsDynamic(constraint.bodyB);
+
+	for (size_t index = 0; index < constraint.pointCount; ++index)
+	{
+		const SContactPoint& point = constraint.points[index];
+
+		/** Separation of the anchors after integration and the previous corrections **/
+		const Vec2 anchorA = polyA.TransformPoint(point.localAnchorA);
+		const Vec2 anchorB = polyB.TransformPoint(point.localAnchorB);
+		const float separation = (anchorB - anchorA) | constraint.normal;
+		minSeparation = Min(minSeparation, separation);
+
+		const Vec2 contactPoint = (anchorA + anchorB) * 0.5f;
+		const Vec2 rA = contactPoint - polyA.position;
+		const Vec2 rB = contactPoint - polyB.position;
+
+		const float correction = Clamp(m_settings.baumgarte * (separation + m_settings.linearSlop), -m_settings.maxCorrection, 0.0f);
+
+		const float rnA = rA ^ constraint.normal;
+		const float rnB = rB ^ constraint.normal;
+		const float K = constraint.bodyA.invMass + constraint.bodyB.invMass + constraint.bodyA.invInertia * rnA * rnA + constraint.bodyB.invInertia * rnB * rnB;
+		if (K <= 0.0f) continue;
+
+		const Vec2 impulse = constraint.normal * (-correction / K);
+
+		if (dynamicA)
+		{
+			polyA.position -= impulse * constraint.bodyA.invMass;
+			polyA.rotation.Rotate(RAD2DEG(-constraint.bodyA.invInertia * (rA ^ impulse)));
+		}
+
+		if (dynamicB)
+		{
+			polyB.position += impulse * constraint.bodyB.invMass;
+			polyB.rotation.Rotate(RAD2DEG(constraint.bodyB.invInertia * (rB ^ impulse)));
+		}
+	}
+
+	return minSeparation;
+}
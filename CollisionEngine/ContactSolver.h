@@ -0,0 +1,121 @@
+#ifndef _CONTACT_SOLVER_H_
+#define _CONTACT_SOLVER_H_
+
+#include <vector>
+#include <cstdint>
+#include <functional>
+#include "Maths.h"
+
+class CPolygon;
+struct SCollision;
+
+struct SSolverSettings
+{
+	size_t	velocityIterations = 8;
+	size_t	positionIterations = 3;
+	bool	warmStarting = true;
+	bool	blockSolver = true;				// both points of a 2 point manifold at once through Solve2DLCP
+
+	float	friction = 0.4f;
+	float	restitution = 0.0f;
+	float	restitutionThreshold = 1.0f;	// relative normal speed under which contacts don't bounce
+
+	float	baumgarte = 0.2f;				// part of the penetration removed per position iteration
+	float	linearSlop = 0.005f;			// penetration left on purpose to keep contacts alive
+	float	maxCorrection = 0.2f;
+};
+
+/** Sequential impulses on the contact manifolds of a step : effective masses are computed once in the pre-step,
+velocity iterations clamp the accumulated impulses, position iterations push the remaining penetration out.
+Constraints are grouped by colors sharing no dynamic body, the big colors are solved on the thread pool **/
+class CContactSolver
+{
+public:
+	void	Init(std::vector<SCollision>& collisions, const SSolverSettings& settings);
+
+	void	WarmStart();
+	void	SolveVelocityConstraints();
+	// Writes the accumulated impulses back into the manifolds for the contact cache
+	void	StoreImpulses();
+
+	// True once every contact is within linearSlop of touching
+	bool	SolvePositionConstraints();
+
+	// 0 when the last Init didn't color the constraints
+	size_t	GetColorCount() const;
+
+private:
+	struct SBody
+	{
+		CPolygon*	poly;
+		float		invMass;
+		float		invInertia;
+	};
+
+	struct SColor
+	{
+		size_t	begin;
+		size_t	end;
+	};
+
+	struct SContactPoint
+	{
+		Vec2	rA, rB;					// from the centers of mass at detection time
+		Vec2	localAnchorA;			// deepest point of A, in A space
+		Vec2	localAnchorB;			// deepest point of B, in B space
+		float	normalImpulse;
+		float	tangentImpulse;
+		float	normalMass;
+		float	tangentMass;
+		float	velocityBias;
+	};
+
+	struct SContactConstraint
+	{
+		SCollision*		collision;
+		SBody			bodyA, bodyB;
+		Vec2			normal;
+		Vec2			tangent;
+		float			friction;
+		size_t			pointCount;
+		SContactPoint	points[2];
+
+		/** 2 point manifolds, normal rows of both points : K * impulses = relative normal velocities **/
+		bool			blockSolve;
+		Mat2			K;
+		Mat2			invK;
+	};
+
+	static SBody	MakeBody(CPolygon& poly);
+	static bool		IsDynamic(const SBody& body);
+	static void		ApplyImpulse(SContactConstraint& constraint, const SContactPoint& point, const Vec2& impulse);
+	static float	GetNormalVelocity(const SContactConstraint& constraint, const SContactPoint& point);
+
+	void			SolveNormalSequential(SContactConstraint& constraint);
+	// False if the LCP has no solution (the caller then goes sequential)
+	bool			SolveNormalBlock(SContactConstraint& constraint);
+
+	void			SolveVelocityConstraint(SContactConstraint& constraint);
+	float			SolvePositionConstraint(SContactConstraint& constraint);
+
+	// Greedy coloring of m_constraints, reorders them color after color when the solve can run in parallel
+	void			BuildColors();
+	// Calls solveRange on consecutive constraint ranges, colors one after the other
+	void			ForEachColor(const std::function<void(size_t, size_t)>& solveRange);
+
+	std::vector<SContactConstraint>	m_constraints;
+	SSolverSettings					m_settings;
+
+	/** Colors are bits of a body mask, constraints finding no free color (or all of them without coloring) end up after m_overflowBegin and are solved serially **/
+	static const size_t				m_maxColors = 64;
+	std::vector<SColor>				m_colors;
+	size_t							m_overflowBegin = 0;
+	std::vector<uint64_t>			m_bodyColors;
+	std::vector<size_t>				m_constraintColors;
+	std::vector<SContactConstraint>	m_sortedConstraints;
+
+	size_t							m_parallelColorThreshold = 256;
+	size_t							m_taskSize = 64;
+};
+
+#endif
@@ -0,0 +1,333 @@
+#include "GJK.h"
+#include "Polygon.h"
+#include "Collision.h"
+
+#include <cfloat>
+
+namespace
+{
+	const int	s_maxGJKIterations = 32;
+	const int	s_maxEPAVertices = 64;
+	const float	s_epaTolerance = 1e-4f;
+
+	/** Simplex vertex : support points of A and B and their difference, with its barycentric weight **/
+	struct SSimplexVertex
+	{
+		Vec2	wA;
+		Vec2	wB;
+		Vec2	w;
+		float	a;
+		size_t	indexA;
+		size_t	indexB;
+	};
+
+	struct SSimplex
+	{
+		SSimplexVertex	v[3];
+		int				count = 0;
+
+		Vec2	GetSearchDirection() const
+		{
+			if (count == 1)
+				return v[0].w * -1.0f;
+
+			/** Perpendicular of the segment on the side of the origin **/
+			const Vec2 e12 = v[1].w - v[0].w;
+			const float sign = e12 ^ (v[0].w * -1.0f);
+			return (sign > 0.0f) ? e12.GetNormal() : e12.GetNormal() * -1.0f;
+		}
+
+		void	GetWitnessPoints(Vec2& pointA, Vec2& pointB) const
+		{
+			pointA = Vec2();
+			pointB = Vec2();
+			for (int index = 0; index < count; ++index)
+			{
+				pointA += v[index].wA * v[index].a;
+				pointB += v[index].wB * v[index].a;
+			}
+		}
+
+		/** Closest point of the segment to the origin, drops the vertex that doesn't contribute **/
+		void	Solve2()
+		{
+			const Vec2 e12 = v[1].w - v[0].w;
+
+			const float d12_2 = -(v[0].w | e12);
+			if (d12_2 <= 0.0f)
+			{
+				v[0].a = 1.0f;
+				count = 1;
+				return;
+			}
+
+			const float d12_1 = v[1].w | e12;
+			if (d12_1 <= 0.0f)
+			{
+				v[1].a = 1.0f;
+				v[0] = v[1];
+				count = 1;
+				return;
+			}
+
+			const float invD12 = 1.0f / (d12_1 + d12_2);
+			v[0].a = d12_1 * invD12;
+			v[1].a = d12_2 * invD12;
+			count = 2;
+		}
+
+		/** Voronoi regions of the triangle, count stays 3 only if the origin is inside **/
+		void	Solve3()
+		{
+			const Vec2 w1 = v[0].w;
+			const Vec2 w2 = v[1].w;
+			const Vec2 w3 = v[2].w;
+
+			const Vec2 e12 = w2 - w1;
+			const float d12_1 = w2 | e12;
+			const float d12_2 = -(w1 | e12);
+
+			const Vec2 e13 = w3 - w1;
+			const float d13_1 = w3 | e13;
+			const float d13_2 = -(w1 | e13);
+
+			const Vec2 e23 = w3 - w2;
+			const float d23_1 = w3 | e23;
+			const float d23_2 = -(w2 | e23);
+
+			const float n123 = e12 ^ e13;
+			const float d123_1 = n123 * (w2 ^ w3);
+			const float d123_2 = n123 * (w3 ^ w1);
+			const float d123_3 = n123 * (w1 ^ w2);
+
+			if (d12_2 <= 0.0f && d13_2 <= 0.0f)
+			{
+				v[0].a = 1.0f;
+				count = 1;
+				return;
+			}
+
+			if (d12_1 > 0.0f && d12_2 > 0.0f && d123_3 <= 0.0f)
+			{
+				const float invD12 = 1.0f / (d12_1 + d12_2);
+				v[0].a = d12_1 * invD12;
+				v[1].a = d12_2 * invD12;
+				count = 2;
+				return;
+			}
+
+			if (d13_1 > 0.0f && d13_2 > 0.0f && d123_2 <= 0.0f)
+			{
+				const float invD13 = 1.0f / (d13_1 + d13_2);
+				v[0].a = d13_1 * invD13;
+				v[2].a = d13_2 * invD13;
+				v[1] = v[2];
+				count = 2;
+				return;
+			}
+
+			if (d12_1 <= 0.0f && d23_2 <= 0.0f)
+			{
+				v[1].a = 1.0f;
+				v[0] = v[1];
+				count = 1;
+				return;
+			}
+
+			if (d13_1 <= 0.0f && d23_1 <= 0.0f)
+			{
+				v[2].a = 1.0f;
+				v[0] = v[2];
+				count = 1;
+				return;
+			}
+
+			if (d23_1 > 0.0f && d23_2 > 0.0f && d123_1 <= 0.0f)
+			{
+				const float invD23 = 1.0f / (d23_1 + d23_2);
+				v[1].a = d23_1 * invD23;
+				v[2].a = d23_2 * invD23;
+				v[0] = v[2];
+				count = 2;
+				return;
+			}
+
+			const float invD123 = 1.0f / (d123_1 + d123_2 + d123_3);
+			v[0].a = d123_1 * invD123;
+			v[1].a = d123_2 * invD123;
+			v[2].a = d123_3 * invD123;
+			count = 3;
+		}
+	};
+
+	void	SetSupportVertex(const CPolygon& polyA, const CPolygon& polyB, const Vec2& direction, SSimplexVertex& vertex)
+	{
+		vertex.indexA = polyA.GetSupportIndex(direction * -1.0f);
+		vertex.indexB = polyB.GetSupportIndex(direction);
+		vertex.wA = polyA.GetWorldPoints()[vertex.indexA];
+		vertex.wB = polyB.GetWorldPoints()[vertex.indexB];
+		vertex.w = vertex.wB - vertex.wA;
+	}
+
+	void	RunGJK(const CPolygon& polyA, const CPolygon& polyB, SSimplex& simplex, SDistanceOutput& output)
+	{
+		simplex.count = 1;
+		SetSupportVertex(polyA, polyB, polyB.position - polyA.position, simplex.v[0]);
+		simplex.v[0].a = 1.0f;
+
+		output.overlap = false;
+		output.iterations = 0;
+
+		while (output.iterations < s_maxGJKIterations)
+		{
+			++output.iterations;
+
+			const SSimplex previous = simplex;
+
+			if (simplex.count == 2) simplex.Solve2();
+			else if (simplex.count == 3) simplex.Solve3();
+
+			if (simplex.count == 3)
+			{
+				output.overlap = true;
+				break;
+			}
+
+			const Vec2 direction = simplex.GetSearchDirection();
+
+			/** Origin lies on the simplex : touching, handled as an overlap of depth 0 by EPA **/
+			if (direction.GetSqrLength() < FLT_EPSILON * FLT_EPSILON)
+			{
+				output.overlap = true;
+				break;
+			}
+
+			SSimplexVertex& vertex = simplex.v[simplex.count];
+			SetSupportVertex(polyA, polyB, direction, vertex);
+
+			/** Same support pair as an earlier vertex, no progress possible **/
+			bool duplicate = false;
+			for (int index = 0; index < previous.count; ++index)
+			{
+				if (vertex.indexA == previous.v[index].indexA && vertex.indexB == previous.v[index].indexB)
+				{
+					duplicate = true;
+					break;
+				}
+			}
+			if (duplicate) break;
+
+			++simplex.count;
+		}
+
+		simplex.GetWitnessPoints(output.pointA, output.pointB);
+		output.distance = output.overlap ? 0.0f : (output.pointB - output.pointA).GetLength();
+	}
+
+	Vec2	GetSupport(const CPolygon& polyA, const CPolygon& polyB, const Vec2& direction)
+	{
+		SSimplexVertex vertex;
+		SetSupportVertex(polyA, polyB, direction, vertex);
+		return vertex.w;
+	}
+
+	/** Expanding polytope on B - A, starting from the GJK simplex. Returns the outward normal of the closest face and its depth **/
+	void	RunEPA(const CPolygon& polyA, const CPolygon& polyB, const SSimplex& simplex, Vec2& normal, float& depth)
+	{
+		Vec2 polytope[s_maxEPAVertices];
+		int count = 0;
+
+		for (int index = 0; index < simplex.count; ++index)
+			polytope[count++] = simplex.v[index].w;
+
+		/** Touching cases end GJK on a point or a segment, grow it into a triangle **/
+		if (count == 1)
+		{
+			polytope[count++] = GetSupport(polyA, polyB, Vec2(1.0f, 0.0f));
+			if ((polytope[1] - polytope[0]).GetSqrLength() < FLT_EPSILON)
+				polytope[1] = GetSupport(polyA, polyB, Vec2(-1.0f, 0.0f));
+		}
+		if (count == 2)
+		{
+			const Vec2 perpendicular = (polytope[1] - polytope[0]).GetNormal();
+			polytope[count] = GetSupport(polyA, polyB, perpendicular);
+			if (((polytope[count] - polytope[0]) ^ (polytope[1] - polytope[0])) == 0.0f)
+				polytope[count] = GetSupport(polyA, polyB, perpendicular * -1.0f);
+			++count;
+		}
+
+		/** Counter clockwise winding so edge normals (e.y, -e.x) point outward **/
+		if (((polytope[1] - polytope[0]) ^ (polytope[2] - polytope[0])) < 0.0f)
+		{
+			const Vec2 swap = polytope[1];
+			polytope[1] = polytope[2];
+			polytope[2] = swap;
+		}
+
+		normal = Vec2();
+		depth = 0.0f;
+
+		for (;;)
+		{
+			int closestEdge = 0;
+			float closestDistance = FLT_MAX;
+			Vec2 closestNormal;
+
+			for (int index = 0; index < count; ++index)
+			{
+				const Vec2 edge = polytope[(index + 1) % count] - polytope[index];
+				const float edgeLength = edge.GetLength();
+				if (edgeLength < FLT_EPSILON) continue;
+
+				const Vec2 edgeNormal = Vec2(edge.y, -edge.x) / edgeLength;
+				const float distance = edgeNormal | polytope[index];
+				if (distance < closestDistance)
+				{
+					closestDistance = distance;
+					closestNormal = edgeNormal;
+					closestEdge = index;
+				}
+			}
+
+			normal = closestNormal;
+			depth = Max(closestDistance, 0.0f);
+
+			const Vec2 support = GetSupport(polyA, polyB, closestNormal);
+			if ((support | closestNormal) - closestDistance < s_epaTolerance || count == s_maxEPAVertices)
+				return;
+
+			/** Insert the support point between the two vertices of the closest edge **/
+			for (int index = count; index > closestEdge + 1; --index)
+				polytope[index] = polytope[index - 1];
+			polytope[closestEdge + 1] = support;
+			++count;
+		}
+	}
+}
+
+void	ComputeDistance(const CPolygon& polyA, const CPolygon& polyB, SDistanceOutput& output)
+{
+	SSimplex simplex;
+	RunGJK(polyA, polyB, simplex, output);
+}
+
+bool	GJKCheckCollision(const CPolygon& polyA, const CPolygon& polyB, SCollision& collision)
+{
+	SSimplex simplex;
+	SDistanceOutput output;
+	RunGJK(polyA, polyB, simplex, output);
+
+	if (!output.overlap)
+		return false;
+
+	Vec2 normal;
+	float depth;
+	RunEPA(polyA, polyB, simplex, normal, depth);
+
+	/** Origin is depth inside B - A along normal, B leaves A along -normal : A toward B is -normal **/
+	collision.normal = normal * -1.0f;
+	collision.distance = depth;
+	collision.point = polyB.GetWorldPoints()[polyB.GetSupportIndex(normal)];
+
+	return true;
+}
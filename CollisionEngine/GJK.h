@@ -0,0 +1,24 @@
+#ifndef _GJK_H_
+#define _GJK_H_
+
+#include "Maths.h"
+
+class CPolygon;
+struct SCollision;
+
+struct SDistanceOutput
+{
+	Vec2	pointA;		// closest point on A, world space
+	Vec2	pointB;		// closest point on B, world space
+	float	distance = 0.0f;
+	bool	overlap = false;
+	int		iterations = 0;
+};
+
+// GJK on the Minkowski difference B - A using CPolygon support queries, closest points are only meaningful if !overlap
+void	ComputeDistance(const CPolygon& polyA, const CPolygon& polyB, SDistanceOutput& output);
+
+// GJK, then EPA on overlap. Same output as CPolygon::CheckCollision : normal from A toward B, distance = penetration
+bool	GJKCheckCollision(const CPolygon& polyA, const CPolygon& polyB, SCollision& collision);
+
+#endif
@@ -8,6 +8,7 @@ struct SGlobalVariables
 	class CWorld*			pWorld;
 	class CSceneManager*	pSceneManager;
 	class CPhysicEngine*	pPhysicEngine;
+	class CThreadPool*		pThreadPool;
 
 	bool					bDebug;
 };
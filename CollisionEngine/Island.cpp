@@ -0,0 +1,92 @@
+#include "Island.h"
+
+#include "GlobalVariables.h"
+#include "World.h"
+#include "Collision.h"
+
+size_t	CIslandGraph::FindRoot(size_t index)
+{
+	/** Path halving, every visited node skips its parent **/
+	while (m_parents[index] != index)
+	{
+		m_parents[index] = m_parents[m_parents[index]];
+		index = m_parents[index];
+	}
+	return index;
+}
+
+void	CIslandGraph::Link(size_t indexA, size_t indexB)
+{
+	const size_t rootA = FindRoot(indexA);
+	const size_t rootB = FindRoot(indexB);
+
+	/** Smallest index as root keeps the islands in world order **/
+	if (rootA < rootB)
+		m_parents[rootB] = rootA;
+	else if (rootB < rootA)
+		m_parents[rootA] = rootB;
+}
+
+void	CIslandGraph::Build(const std::vector<SCollision>& collisions)
+{
+	const size_t polyCount = gVars->pWorld->GetPolygonCount();
+
+	m_parents.resize(polyCount);
+	for (size_t index = 0; index < polyCount; ++index)
+	{
+		m_parents[index] = index;
+	}
+
+	for (const SCollision& collision : collisions)
+	{
+		if (collision.polyA->density == 0.0f || collision.polyB->density == 0.0f)
+			continue;
+
+		Link(collision.polyA->GetIndex(), collision.polyB->GetIndex());
+	}
+
+	/** Count the bodies of every root, then place them island after island **/
+	const size_t noIsland = (size_t)-1;
+	m_islandOfRoot.assign(polyCount, noIsland);
+	m_islands.clear();
+
+	for (size_t index = 0; index < polyCount; ++index)
+	{
+		const CPolygonPtr poly = gVars->pWorld->GetPolygon(index);
+		if (poly->density == 0.0f || poly->GetIndex() != index)
+			continue;
+
+		const size_t root = FindRoot(index);
+		if (m_islandOfRoot[root] == noIsland)
+		{
+			m_islandOfRoot[root] = m_islands.size();
+			m_islands.push_back({ 0, 0 });
+		}
+		++m_islands[m_islandOfRoot[root]].end;
+	}
+
+	size_t begin = 0;
+	for (SIsland& island : m_islands)
+	{
+		const size_t count = island.end;
+		island.begin = begin;
+		island.end = begin;
+		begin += count;
+	}
+
+	m_bodies.resize(begin);
+	for (size_t index = 0; index < polyCount; ++index)
+	{
+		const CPolygonPtr poly = gVars->pWorld->GetPolygon(index);
+		if (poly->density == 0.0f || poly->GetIndex() != index)
+			continue;
+
+		SIsland& island = m_islands[m_islandOfRoot[FindRoot(index)]];
+		m_bodies[island.end++] = poly.get();
+	}
+}
+
+size_t	CIslandGraph::GetIslandCount() const
+{
+	return m_islands.size();
+}
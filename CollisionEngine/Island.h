@@ -0,0 +1,44 @@
+#ifndef _ISLAND_H_
+#define _ISLAND_H_
+
+#include <vector>
+#include "Polygon.h"
+
+struct SCollision;
+
+/** Dynamic bodies linked by contacts, built again every step with a union find on the polygon indices.
+Statics don't link islands : two piles resting on the same ground sleep and wake independently **/
+class CIslandGraph
+{
+public:
+	void	Build(const std::vector<SCollision>& collisions);
+
+	size_t	GetIslandCount() const;
+
+	// functor(CPolygon* const* bodies, size_t bodyCount) for every island, a lone dynamic body is an island too
+	template<typename TFunctor>
+	void	ForEachIsland(TFunctor functor) const
+	{
+		for (const SIsland& island : m_islands)
+		{
+			functor(m_bodies.data() + island.begin, island.end - island.begin);
+		}
+	}
+
+private:
+	struct SIsland
+	{
+		size_t	begin;
+		size_t	end;
+	};
+
+	size_t	FindRoot(size_t index);
+	void	Link(size_t indexA, size_t indexB);
+
+	std::vector<size_t>		m_parents;
+	std::vector<size_t>		m_islandOfRoot;
+	std::vector<SIsland>	m_islands;
+	std::vector<CPolygon*>	m_bodies;	// bodies of every island, island after island
+};
+
+#endif
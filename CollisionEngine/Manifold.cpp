@@ -0,0 +1,174 @@
+#include "Manifold.h"
+
+#include "Polygon.h"
+#include "Collision.h"
+
+#include <cfloat>
+
+namespace
+{
+	/** Point of the incident edge with the features that produced it : incident vertex against the reference edge,
+	or reference vertex against the incident edge for a side plane cut **/
+	struct SClipVertex
+	{
+		Vec2				point;
+		size_t				referenceIndex;
+		ContactFeatureType	referenceType;
+		size_t				incidentIndex;
+		ContactFeatureType	incidentType;
+	};
+
+	size_t	GetMostAlignedEdge(const std::vector<Vec2>& normals, const Vec2& direction, float& alignment)
+	{
+		size_t bestEdge = 0;
+		alignment = -FLT_MAX;
+		for (size_t index = 0; index < normals.size(); ++index)
+		{
+			const float dot = normals[index] | direction;
+			if (dot > alignment)
+			{
+				alignment = dot;
+				bestEdge = index;
+			}
+		}
+		return bestEdge;
+	}
+
+	/** Keeps the part of segment in with dot(normal, point) <= offset, the cut point comes from reference vertex clipIndex **/
+	size_t	ClipSegment(const SClipVertex in[2], SClipVertex out[2], const Vec2& normal, float offset, size_t clipIndex, size_t incidentEdge)
+	{
+		size_t count = 0;
+		const float distance0 = (normal | in[0].point) - offset;
+		const float distance1 = (normal | in[1].point) - offset;
+
+		if (distance0 <= 0.0f) out[count++] = in[0];
+		if (distance1 <= 0.0f) out[count++] = in[1];
+
+		if (distance0 * distance1 < 0.0f)
+		{
+			const float ratio = distance0 / (distance0 - distance1);
+			out[count].point = in[0].point + (in[1].point - in[0].point) * ratio;
+			out[count].referenceIndex = clipIndex;
+			out[count].referenceType = ContactFeatureType::Vertex;
+			out[count].incidentIndex = incidentEdge;
+			out[count].incidentType = ContactFeatureType::Edge;
+			++count;
+		}
+
+		return count;
+	}
+
+	void	SetSinglePoint(SCollision& collision)
+	{
+		SContactInfo& contact = collision.manifold[0];
+		contact.pA = collision.polyA.get();
+		contact.pB = collision.polyB.get();
+		contact.point = collision.point;
+		contact.normal = collision.normal;
+		contact.penetration = collision.distance;
+		contact.index = MakeContactFeature(0, ContactFeatureType::Vertex, 0, ContactFeatureType::Vertex);
+		collision.manifoldSize = 1;
+	}
+}
+
+void	GenerateManifold(SCollision& collision)
+{
+	const CPolygon& polyA = *collision.polyA;
+	const CPolygon& polyB = *collision.polyB;
+
+	/** Circles have no edge, their kernel point is the whole manifold **/
+	if (polyA.shapeType == ShapeType::Circle || polyB.shapeType == ShapeType::Circle)
+	{
+		SetSinglePoint(collision);
+		return;
+	}
+
+	/** Reference edge : the one whose normal is closest to the collision normal, A wins near ties to keep the choice stable **/
+	float alignmentA, alignmentB;
+	const size_t edgeA = GetMostAlignedEdge(polyA.GetWorldNormals(), collision.normal, alignmentA);
+	const size_t edgeB = GetMostAlignedEdge(polyB.GetWorldNormals(), collision.normal * -1.0f, alignmentB);
+
+	const bool flip = (alignmentB > alignmentA + 0.001f);
+	const CPolygon& reference = flip ? polyB : polyA;
+	const CPolygon& incident = flip ? polyA : polyB;
+	const size_t referenceEdge = flip ? edgeB : edgeA;
+
+	const std::vector<Vec2>& referencePoints = reference.GetWorldPoints();
+	const std::vector<Vec2>& incidentPoints = incident.GetWorldPoints();
+	const Vec2& referenceNormal = reference.GetWorldNormals()[referenceEdge];
+
+	const size_t referenceIndex2 = (referenceEdge + 1) % referencePoints.size();
+	const Vec2& referenceVertex1 = referencePoints[referenceEdge];
+	const Vec2& referenceVertex2 = referencePoints[referenceIndex2];
+
+	/** Incident edge : most anti parallel to the reference normal **/
+	float incidentAlignment;
+	const size_t incidentEdge = GetMostAlignedEdge(incident.GetWorldNormals(), referenceNormal * -1.0f, incidentAlignment);
+	const size_t incidentIndex2 = (incidentEdge + 1) % incidentPoints.size();
+
+	SClipVertex incidentVertices[2] = {
+		{ incidentPoints[incidentEdge], referenceEdge, ContactFeatureType::Edge, incidentEdge, ContactFeatureType::Vertex },
+		{ incidentPoints[incidentIndex2], referenceEdge, ContactFeatureType::Edge, incidentIndex2, ContactFeatureType::Vertex },
+	};
+
+	/** Side planes of the reference edge **/
+	const Vec2 tangent = (referenceVertex2 - referenceVertex1).Normalized();
+
+	SClipVertex clipped1[2], clipped2[2];
+	size_t count = ClipSegment(incidentVertices, clipped1, tangent * -1.0f, -(tangent | referenceVertex1), referenceEdge, incidentEdge);
+	if (count == 2)
+		count = ClipSegment(clipped1, clipped2, tangent, tangent | referenceVertex2, referenceIndex2, incidentEdge);
+
+	const float totalRadius = reference.radius + incident.radius;
+	const float referenceOffset = referenceNormal | referenceVertex1;
+
+	/** Points behind the reference face (inflated by both radii) touch, contact goes half way between both surfaces **/
+	collision.manifoldSize = 0;
+	if (count == 2)
+	{
+		for (const SClipVertex& vertex : clipped2)
+		{
+			const float separation = (referenceNormal | vertex.point) - referenceOffset - totalRadius;
+			if (separation > 0.0f)
+				continue;
+
+			SContactInfo& contact = collision.manifold[collision.manifoldSize++];
+			contact.pA = collision.polyA.get();
+			contact.pB = collision.polyB.get();
+			contact.normal = collision.normal;
+			contact.penetration = -separation;
+			contact.point = vertex.point - referenceNormal * (0.5f * separation + incident.radius);
+			contact.index = flip
+				? MakeContactFeature(vertex.incidentIndex, vertex.incidentType, vertex.referenceIndex, vertex.referenceType)
+				: MakeContactFeature(vertex.referenceIndex, vertex.referenceType, vertex.incidentIndex, vertex.incidentType);
+		}
+	}
+
+	/** Clipping lost every point : a capsule touching with its cap keeps its kernel point, polygons their deepest incident vertex **/
+	if (collision.manifoldSize == 0 && totalRadius > 0.0f)
+	{
+		SetSinglePoint(collision);
+		return;
+	}
+
+	if (collision.manifoldSize == 0)
+	{
+		const size_t deepest = incident.GetSupportIndex(referenceNormal * -1.0f);
+		const float separation = (referenceNormal | incidentPoints[deepest]) - referenceOffset - totalRadius;
+
+		SContactInfo& contact = collision.manifold[0];
+		contact.pA = collision.polyA.get();
+		contact.pB = collision.polyB.get();
+		contact.normal = collision.normal;
+		contact.penetration = Max(-separation, 0.0f);
+		contact.point = incidentPoints[deepest] - referenceNormal * (0.5f * separation + incident.radius);
+		contact.index = flip
+			? MakeContactFeature(deepest, ContactFeatureType::Vertex, referenceEdge, ContactFeatureType::Edge)
+			: MakeContactFeature(referenceEdge, ContactFeatureType::Edge, deepest, ContactFeatureType::Vertex);
+		collision.manifoldSize = 1;
+	}
+
+	collision.point = collision.manifold[0].point;
+	if (collision.manifoldSize == 2)
+		collision.point = (collision.manifold[0].point + collision.manifold[1].point) * 0.5f;
+}
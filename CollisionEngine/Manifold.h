@@ -0,0 +1,11 @@
+#ifndef _MANIFOLD_H_
+#define _MANIFOLD_H_
+
+struct SCollision;
+
+// Fills collision.manifold from the kernel normal : incident edge clipped against the side planes of the reference edge,
+// at most 2 points with their feature ids, no allocation. Pairs with a circle keep the single kernel point.
+// collision.point is set to the middle of the manifold points
+void	GenerateManifold(SCollision& collision);
+
+#endif
@@ -29,6 +29,18 @@ Vec2 maxv(const Vec2& a, const Vec2& b)
 	return Vec2(Max(a.x, b.x), Max(a.y, b.y));
 }
 
+Vec2 ClosestPointOnSegment(const Vec2& a, const Vec2& b, const Vec2& point)
+{
+	const Vec2 segment = b - a;
+	const float sqrLength = segment.GetSqrLength();
+	if (sqrLength == 0.0f)
+	{
+		return a;
+	}
+
+	return a + segment * Clamp(((point - a) | segment) / sqrLength, 0.0f, 1.0f);
+}
+
 bool Clip(const Vec2& center, const Vec2& normal, Vec2& pt1, Vec2& pt2)
 {
 	float dist1 = (pt1 - center) | normal;
@@ -101,11 +113,11 @@ bool Solve2DLCP(const Mat2& A, const Mat2& invA, const Vec2& b, Vec2& x)
 	// a12 * x2 + b1 = y1  &&   a22 * x2 + b2 = 0
 	// x2 = -b2 / a22
 	// y1 = a12 * x2 + b1
-	if (A.Y.x != 0.0f)
+	if (A.Y.y != 0.0f)
 	{
 		x.y = -b.y / A.Y.y;
 		y.x = A.Y.x * x.y + b.x;
-		if (x.x >= 0.0f && y.y >= 0.0f)
+		if (x.y >= 0.0f && y.x >= 0.0f)
 		{
 			x.x = 0.0f;
 			return true;
@@ -180,6 +180,8 @@ struct Vec2
 Vec2 minv(const Vec2& a, const Vec2& b);
 Vec2 maxv(const Vec2& a, const Vec2& b);
 
+Vec2 ClosestPointOnSegment(const Vec2& a, const Vec2& b, const Vec2& point);
+
 struct Mat2
 {
 	Vec2 X, Y;
@@ -196,7 +198,7 @@ struct Mat2
 
 	Mat2	GetInverse() const
 	{
-		return Mat2(Y.y, -X.y, -Y.x, X.x) * (1.0f/GetDeterminant());
+		return Mat2(Y.y, -Y.x, -X.y, X.x) * (1.0f/GetDeterminant());
 	}
 
 	Mat2	GetInverseOrtho() const
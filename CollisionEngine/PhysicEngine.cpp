@@ -10,18 +10,69 @@
 #include "BroadPhase.h"
 #include "BroadPhaseBrut.h"
 #include "CBroadPhaseAABBTree.h"
+#include "CBroadPhaseSAP.h"
+#include "CBroadPhaseGrid.h"
+#include "GJK.h"
+#include "ShapeCollision.h"
+#include "ThreadPool.h"
+#include "SatBatch.h"
+#include "Manifold.h"
 
 
+namespace
+{
+	bool	CollidePolygons(const CPolygon& polyA, const CPolygon& polyB, SCollision& collision, SSatCache* cache)
+	{
+		return polyA.CheckCollision(polyB, collision, cache);
+	}
+
+	/** Adapter for the kernels that don't use the SAT cache **/
+	template<bool(*Kernel)(const CPolygon&, const CPolygon&, SCollision&)>
+	bool	CollideUncached(const CPolygon& shapeA, const CPolygon& shapeB, SCollision& collision, SSatCache*)
+	{
+		return Kernel(shapeA, shapeB, collision);
+	}
+
+	void	CollideGJKBatch(const SPolygonPair* pairs, size_t count, std::vector<SCollision>& collisions)
+	{
+		for (size_t index = 0; index < count; ++index)
+		{
+			SCollision collision;
+			collision.polyA = pairs[index].polyA;
+			collision.polyB = pairs[index].polyB;
+
+			if (GJKCheckCollision(*collision.polyA, *collision.polyB, collision))
+			{
+				collisions.push_back(collision);
+			}
+		}
+	}
+}
+
+CPhysicEngine::CPhysicEngine()
+{
+	RegisterCollideFunction(ShapeType::Polygon, ShapeType::Polygon, &CollidePolygons);
+	RegisterCollideFunction(ShapeType::Polygon, ShapeType::Circle, &CollideUncached<CollidePolygonCircle>);
+	RegisterCollideFunction(ShapeType::Polygon, ShapeType::Capsule, &CollideUncached<CollidePolygonCapsule>);
+	RegisterCollideFunction(ShapeType::Circle, ShapeType::Circle, &CollideUncached<CollideRoundShapes>);
+	RegisterCollideFunction(ShapeType::Circle, ShapeType::Capsule, &CollideUncached<CollideRoundShapes>);
+	RegisterCollideFunction(ShapeType::Capsule, ShapeType::Capsule, &CollideUncached<CollideRoundShapes>);
+}
 
 void	CPhysicEngine::Reset()
 {
 	m_pairsToCheck.clear();
 	m_collidingPairs.clear();
+	m_satCache.clear();
+	m_contactCache.Clear();
+	m_staticTransforms.clear();
+	m_contactEvents.clear();
+	m_accumulator = 0.0f;
 
 	m_active = true;
 
 	delete m_broadPhase;
-	m_broadPhase = new CBroadPhaseAABBTree();
+	m_broadPhase = CreateBroadPhase(m_broadPhaseType);
 	//pBroadPhase = m_broadPhase;
 }
 
@@ -36,15 +87,15 @@ void	CPhysicEngine::DetectCollisions()
 	timer.Start();
 	CollisionBroadPhase();
 	timer.Stop();
-	if (gVars->bDebug)
+	if (gVars->bDebug && m_drawDebug)
 	{
-		gVars->pRenderer->DisplayText("Collision broadphase duration " + std::to_string(timer.GetDuration() * 1000.0f) + " ms");
+		gVars->pRenderer->DisplayText("Collision broadphase (" + std::string(GetBroadPhaseName()) + ") duration " + std::to_string(timer.GetDuration() * 1000.0f) + " ms");
 	}
 
 	timer.Start();
 	CollisionNarrowPhase();
 	timer.Stop();
-	if (gVars->bDebug)
+	if (gVars->bDebug && m_drawDebug)
 	{
 		gVars->pRenderer->DisplayText("Collision narrowphase duration " + std::to_string(timer.GetDuration() * 1000.0f) + " ms, collisions : " + std::to_string(m_collidingPairs.size()));
 	}
@@ -60,22 +111,337 @@ void	CPhysicEngine::Step(float deltaTime)
 		return;
 	}
 
+	m_timeStep = deltaTime;
+
 	Vec2 gravity(0, -9.8f);
-	float elasticity = 0.6f;
 
+	/** Forces first, contacts are then solved on the velocities the bodies are about to move with **/
+	m_awakeBodyCount = 0;
+	m_movedStaticCount = 0;
+	m_staticTransforms.resize(gVars->pWorld->GetPolygonCount());
 	gVars->pWorld->ForEachPolygon([&](CPolygonPtr poly)
 	{
 		if (poly->density == 0.0f)
+		{
+			UpdateStaticTransform(*poly);
+			return;
+		}
+
+		if (!poly->IsAwake())
 		{
 			return;
 		}
 
-		poly->rotation.Rotate(RAD2DEG(poly->angularVelocity * deltaTime));
-		poly->position += poly->speed * deltaTime;
 		poly->speed += gravity * deltaTime;
+		++m_awakeBodyCount;
+	});
+
+	/** Transform every body once here, detection then only reads the cached world vertices **/
+	gVars->pWorld->ForEachPolygon([&](CPolygonPtr poly)
+	{
+		poly->UpdateWorldCache();
 	});
 
 	DetectCollisions();
+
+	/** Without an awake body no contact can start, islands stay as they fell asleep **/
+	const bool wokeByStatic = m_sleepSettings.enabled && m_movedStaticCount > 0 && WakeTouchedByMovedStatics();
+	const bool updateIslands = m_sleepSettings.enabled && (m_awakeBodyCount > 0 || wokeByStatic);
+	if (updateIslands)
+	{
+		m_islands.Build(m_collidingPairs);
+		WakeIslands();
+	}
+
+	SolveContacts(deltaTime);
+
+	if (updateIslands)
+	{
+		UpdateSleep(deltaTime);
+	}
+
+	if (m_sleepSettings.enabled && gVars->bDebug && m_drawDebug)
+	{
+		gVars->pRenderer->DisplayText("Islands : " + std::to_string(m_islands.GetIslandCount()) + ", sleeping bodies : " + std::to_string(m_sleepingBodyCount));
+	}
+}
+
+void	CPhysicEngine::Update(float frameTime)
+{
+	if (!m_active)
+	{
+		return;
+	}
+
+	const float fixedTimeStep = m_timeStepSettings.fixedTimeStep;
+	const size_t subSteps = Max(m_timeStepSettings.subSteps, (size_t)1);
+
+	m_accumulator += frameTime;
+
+	size_t stepCount = (size_t)(m_accumulator / fixedTimeStep);
+	float droppedTime = 0.0f;
+	if (stepCount > m_timeStepSettings.maxStepsPerFrame)
+	{
+		/** Catching up would cost more than the frame we are late for, drop the whole steps beyond the budget **/
+		droppedTime = (stepCount - m_timeStepSettings.maxStepsPerFrame) * fixedTimeStep;
+		stepCount = m_timeStepSettings.maxStepsPerFrame;
+	}
+
+	/** Debug texts of the last step only, instead of one copy per step **/
+	for (size_t step = 0; step < stepCount; ++step)
+	{
+		gVars->pWorld->ForEachPolygon([&](CPolygonPtr poly)
+		{
+			/** Only integrated bodies are drawn interpolated **/
+			if (poly->density != 0.0f)
+			{
+				poly->SavePreviousTransform();
+			}
+		});
+
+		for (size_t subStep = 0; subStep < subSteps; ++subStep)
+		{
+			m_drawDebug = (step + 1 == stepCount) && (subStep + 1 == subSteps);
+			Step(fixedTimeStep / (float)subSteps);
+		}
+	}
+	m_drawDebug = true;
+
+	m_accumulator -= stepCount * fixedTimeStep + droppedTime;
+	m_accumulator = Max(m_accumulator, 0.0f);
+
+	if (gVars->bDebug)
+	{
+		gVars->pRenderer->DisplayText("Physics steps : " + std::to_string(stepCount) + " x " + std::to_string(subSteps) + " at " + std::to_string(1.0f / fixedTimeStep) + " Hz, dropped " + std::to_string(droppedTime * 1000.0f) + " ms, interpolation " + std::to_string(GetInterpolation()));
+	}
+}
+
+float	CPhysicEngine::GetInterpolation() const
+{
+	return Min(m_accumulator / m_timeStepSettings.fixedTimeStep, 1.0f);
+}
+
+bool	CPhysicEngine::IsDebugStep() const
+{
+	return m_drawDebug;
+}
+
+void	CPhysicEngine::SetTimeStepSettings(const STimeStepSettings& settings)
+{
+	m_timeStepSettings = settings;
+}
+
+const STimeStepSettings&	CPhysicEngine::GetTimeStepSettings() const
+{
+	return m_timeStepSettings;
+}
+
+void	CPhysicEngine::WakeIslands()
+{
+	/** A sleeping island is only touched by awake bodies through a new contact, which merged both in one island **/
+	m_islands.ForEachIsland([&](CPolygon* const* bodies, size_t bodyCount)
+	{
+		bool awake = false;
+		bool asleep = false;
+		for (size_t index = 0; index < bodyCount; ++index)
+		{
+			awake |= bodies[index]->IsAwake();
+			asleep |= !bodies[index]->IsAwake();
+		}
+
+		if (!awake || !asleep)
+		{
+			return;
+		}
+
+		for (size_t index = 0; index < bodyCount; ++index)
+		{
+			if (!bodies[index]->IsAwake())
+			{
+				bodies[index]->SetAwake(true);
+			}
+		}
+	});
+}
+
+void	CPhysicEngine::UpdateSleep(float deltaTime)
+{
+	const float linearTolerance2 = m_sleepSettings.linearTolerance * m_sleepSettings.linearTolerance;
+	m_sleepingBodyCount = 0;
+
+	m_islands.ForEachIsland([&](CPolygon* const* bodies, size_t bodyCount)
+	{
+		/** Islands are all awake or all asleep after WakeIslands **/
+		if (!bodies[0]->IsAwake())
+		{
+			m_sleepingBodyCount += bodyCount;
+			return;
+		}
+
+		float minSleepTime = FLT_MAX;
+		for (size_t index = 0; index < bodyCount; ++index)
+		{
+			CPolygon& body = *bodies[index];
+			if (body.speed.GetSqrLength() > linearTolerance2 || fabsf(body.angularVelocity) > m_sleepSettings.angularTolerance)
+			{
+				body.sleepTime = 0.0f;
+			}
+			else
+			{
+				body.sleepTime += deltaTime;
+			}
+			minSleepTime = Min(minSleepTime, body.sleepTime);
+		}
+
+		if (minSleepTime < m_sleepSettings.timeToSleep)
+		{
+			return;
+		}
+
+		for (size_t index = 0; index < bodyCount; ++index)
+		{
+			bodies[index]->SetAwake(false);
+		}
+		m_sleepingBodyCount += bodyCount;
+	});
+}
+
+void	CPhysicEngine::WakeAll()
+{
+	gVars->pWorld->ForEachPolygon([&](CPolygonPtr poly)
+	{
+		if (!poly->IsAwake())
+		{
+			poly->SetAwake(true);
+		}
+	});
+}
+
+bool	CPhysicEngine::IsSleepingPair(const CPolygon& polyA, const CPolygon& polyB) const
+{
+	/** Static / static pairs never come out of the broadphase, so one of them is a sleeping body **/
+	return !IsMoving(polyA) && !IsMoving(polyB);
+}
+
+bool	CPhysicEngine::IsMoving(const CPolygon& poly) const
+{
+	if (poly.density != 0.0f)
+	{
+		return poly.IsAwake();
+	}
+
+	return poly.GetIndex() < m_staticTransforms.size() && m_staticTransforms[poly.GetIndex()].moved;
+}
+
+void	CPhysicEngine::UpdateStaticTransform(const CPolygon& poly)
+{
+	/** Statics are never integrated, a changed transform means a tool or a scene moved them **/
+	SStaticTransform& transform = m_staticTransforms[poly.GetIndex()];
+	transform.moved = transform.valid && !(poly.position == transform.position && poly.rotation.X == transform.rotation.X && poly.rotation.Y == transform.rotation.Y);
+	transform.position = poly.position;
+	transform.rotation = poly.rotation;
+	transform.valid = true;
+
+	if (transform.moved)
+	{
+		++m_movedStaticCount;
+	}
+}
+
+bool	CPhysicEngine::WakeTouchedByMovedStatics()
+{
+	/** Statics don't link islands, so WakeIslands can't see the contact **/
+	bool woke = false;
+	for (const SCollision& collision : m_collidingPairs)
+	{
+		CPolygon* polys[2] = { collision.polyA.get(), collision.polyB.get() };
+		for (size_t side = 0; side < 2; ++side)
+		{
+			CPolygon& body = *polys[side];
+			const CPolygon& other = *polys[1 - side];
+			if (body.density != 0.0f && !body.IsAwake() && other.density == 0.0f && IsMoving(other))
+			{
+				body.SetAwake(true);
+				woke = true;
+			}
+		}
+	}
+	return woke;
+}
+
+void	CPhysicEngine::SolveContacts(float deltaTime)
+{
+	CTimer timer;
+	timer.Start();
+
+	m_contactSolver.Init(m_collidingPairs, m_solverSettings);
+
+	if (m_solverSettings.warmStarting)
+	{
+		m_contactSolver.WarmStart();
+	}
+
+	for (size_t iteration = 0; iteration < m_solverSettings.velocityIterations; ++iteration)
+	{
+		m_contactSolver.SolveVelocityConstraints();
+	}
+
+	m_contactSolver.StoreImpulses();
+
+	gVars->pWorld->ForEachPolygon([&](CPolygonPtr poly)
+	{
+		if (poly->density == 0.0f || !poly->IsAwake())
+		{
+			return;
+		}
+
+		poly->rotation.Rotate(RAD2DEG(poly->angularVelocity * deltaTime));
+		poly->position += poly->speed * deltaTime;
+	});
+
+	for (size_t iteration = 0; iteration < m_solverSettings.positionIterations; ++iteration)
+	{
+		if (m_contactSolver.SolvePositionConstraints())
+		{
+			break;
+		}
+	}
+
+	timer.Stop();
+	if (gVars->bDebug && m_drawDebug)
+	{
+		gVars->pRenderer->DisplayText("Contact solver duration " + std::to_string(timer.GetDuration() * 1000.0f) + " ms, velocity iterations : " + std::to_string(m_solverSettings.velocityIterations) + ", position iterations : " + std::to_string(m_solverSettings.positionIterations) + ", colors : " + std::to_string(m_contactSolver.GetColorCount()));
+	}
+}
+
+void	CPhysicEngine::SetSolverSettings(const SSolverSettings& settings)
+{
+	m_solverSettings = settings;
+}
+
+void	CPhysicEngine::SetSleepSettings(const SSleepSettings& settings)
+{
+	m_sleepSettings = settings;
+
+	if (!m_sleepSettings.enabled)
+	{
+		WakeAll();
+	}
+}
+
+const SSleepSettings&	CPhysicEngine::GetSleepSettings() const
+{
+	return m_sleepSettings;
+}
+
+const SSolverSettings&	CPhysicEngine::GetSolverSettings() const
+{
+	return m_solverSettings;
+}
+
+float CPhysicEngine::GetTimeStep() const
+{
+	return m_timeStep;
 }
 
 void CPhysicEngine::InitBroadPhase()
@@ -88,25 +454,353 @@ IBroadPhase* CPhysicEngine::GetBroadPhase() const
 	return m_broadPhase;
 }
 
+void CPhysicEngine::QueryAABB(const AABB& aabb, const std::function<bool(const CPolygonPtr&)>& callback)
+{
+	m_broadPhase->QueryAABB(aabb, [&](const CPolygonPtr& poly)
+	{
+		return !poly->IsOverlappingAABB(aabb) || callback(poly);
+	});
+}
+
+void CPhysicEngine::QueryPoint(const Vec2& point, const std::function<bool(const CPolygonPtr&)>& callback)
+{
+	m_broadPhase->QueryPoint(point, [&](const CPolygonPtr& poly)
+	{
+		return !poly->IsPointInside(point) || callback(poly);
+	});
+}
+
+CPolygonPtr CPhysicEngine::QueryPoint(const Vec2& point)
+{
+	CPolygonPtr foundPoly;
+	QueryPoint(point, [&](const CPolygonPtr& poly)
+	{
+		foundPoly = poly;
+		return false;
+	});
+
+	return foundPoly;
+}
+
+bool CPhysicEngine::RayCast(const Vec2& from, const Vec2& to, SRayCastHit& hit)
+{
+	hit.poly.reset();
+	RayCast(from, to, [&](const SRayCastHit& candidate)
+	{
+		hit = candidate;
+		return candidate.fraction;
+	});
+
+	return hit.poly != nullptr;
+}
+
+void CPhysicEngine::RayCast(const Vec2& from, const Vec2& to, const std::function<float(const SRayCastHit&)>& callback)
+{
+	m_broadPhase->RayCast(SRayCastInput(from, to), [&](const SRayCastInput& input, const CPolygonPtr& poly)
+	{
+		SRayCastHit hit;
+		if (!poly->RayCast(input.from, input.to, input.maxFraction, hit.fraction, hit.normal))
+			return input.maxFraction;
+
+		hit.poly = poly;
+		hit.point = input.from + (input.to - input.from) * hit.fraction;
+		return callback(hit);
+	});
+}
+
+void CPhysicEngine::SetBroadPhaseType(BroadPhaseType type)
+{
+	m_broadPhaseType = type;
+}
+
+BroadPhaseType CPhysicEngine::GetBroadPhaseType() const
+{
+	return m_broadPhaseType;
+}
+
+const char* CPhysicEngine::GetBroadPhaseName() const
+{
+	switch (m_broadPhaseType)
+	{
+	case BroadPhaseType::Brut:			return "Brut";
+	case BroadPhaseType::AABBTree:		return "AABB tree";
+	case BroadPhaseType::SweepAndPrune:	return "SAP";
+	case BroadPhaseType::HashGrid:		return "Hash grid";
+	default:							return "Unknown";
+	}
+}
+
+void CPhysicEngine::SetNarrowPhaseType(NarrowPhaseType type)
+{
+	m_narrowPhaseType = type;
+}
+
+NarrowPhaseType CPhysicEngine::GetNarrowPhaseType() const
+{
+	return m_narrowPhaseType;
+}
+
+void CPhysicEngine::SetGJKVertexThreshold(size_t vertexCount)
+{
+	m_gjkVertexThreshold = vertexCount;
+}
+
+void CPhysicEngine::SetPairNarrowPhase(const CPolygon& polyA, const CPolygon& polyB, NarrowPhaseType type)
+{
+	if (type == NarrowPhaseType::Auto)
+		m_pairNarrowPhase.erase(GetPairKey(polyA, polyB));
+	else
+		m_pairNarrowPhase[GetPairKey(polyA, polyB)] = type;
+}
+
+bool CPhysicEngine::UseGJK(const CPolygon& polyA, const CPolygon& polyB) const
+{
+	NarrowPhaseType type = m_narrowPhaseType;
+
+	if (!m_pairNarrowPhase.empty())
+	{
+		auto it = m_pairNarrowPhase.find(GetPairKey(polyA, polyB));
+		if (it != m_pairNarrowPhase.end()) type = it->second;
+	}
+
+	/** SAT tests n + m axes against n + m vertices, GJK a few support queries of n + m vertices **/
+	if (type == NarrowPhaseType::Auto)
+		return Max(polyA.points.size(), polyB.points.size()) > m_gjkVertexThreshold;
+
+	return type == NarrowPhaseType::GJK;
+}
+
+void CPhysicEngine::SetSatBatchEnabled(bool enabled)
+{
+	m_satBatchEnabled = enabled;
+}
+
+void CPhysicEngine::RegisterCollideFunction(ShapeType typeA, ShapeType typeB, TCollideFunction function)
+{
+	const bool swapped = (typeA > typeB);
+	SCollideEntry& entry = swapped ? m_collideFunctions[(size_t)typeB][(size_t)typeA] : m_collideFunctions[(size_t)typeA][(size_t)typeB];
+	entry.function = function;
+	entry.swapped = swapped;
+}
+
+IBroadPhase* CPhysicEngine::CreateBroadPhase(BroadPhaseType type)
+{
+	switch (type)
+	{
+	case BroadPhaseType::Brut:			return new CBroadPhaseBrut();
+	case BroadPhaseType::SweepAndPrune:	return new CBroadPhaseSAP();
+	case BroadPhaseType::HashGrid:		return new CBroadPhaseGrid();
+	case BroadPhaseType::AABBTree:
+	default:							return new CBroadPhaseAABBTree();
+	}
+}
+
 void	CPhysicEngine::CollisionBroadPhase()
 {
 	m_pairsToCheck.clear();
 	m_broadPhase->GetCollidingPairsToCheck(m_pairsToCheck);
 }
 
-void	CPhysicEngine::CollisionNarrowPhase()
+void	CPhysicEngine::BatchPairs()
 {
-	m_collidingPairs.clear();
+	for (auto& batches : m_pairBatches)
+	{
+		for (std::vector<SPolygonPair>& batch : batches)
+			batch.clear();
+	}
+	m_gjkBatch.clear();
+	m_satBatch.clear();
 
 	for (const SPolygonPair& pair : m_pairsToCheck)
 	{
+		if (IsSleepingPair(*pair.polyA, *pair.polyB))
+			continue;
+
+		const size_t typeA = (size_t)pair.polyA->shapeType;
+		const size_t typeB = (size_t)pair.polyB->shapeType;
+
+		if (typeA == (size_t)ShapeType::Polygon && typeB == (size_t)ShapeType::Polygon && UseGJK(*pair.polyA, *pair.polyB))
+			m_gjkBatch.push_back(pair);
+		else if (m_satBatchEnabled && IsSatBatchSimd() && IsSatBatchCandidate(*pair.polyA) && IsSatBatchCandidate(*pair.polyB))
+			m_satBatch.push_back(pair);
+		else if (typeA <= typeB)
+			m_pairBatches[typeA][typeB].push_back(pair);
+		else
+			m_pairBatches[typeB][typeA].push_back(SPolygonPair(pair.polyB, pair.polyA));
+	}
+
+	/** Inserting in the map may rehash but element addresses stay valid **/
+	const std::vector<SPolygonPair>& polygonPairs = m_pairBatches[(size_t)ShapeType::Polygon][(size_t)ShapeType::Polygon];
+	m_batchSatCaches.resize(polygonPairs.size());
+	for (size_t index = 0; index < polygonPairs.size(); ++index)
+	{
+		SSatCache& satCache = m_satCache[GetPairKey(*polygonPairs[index].polyA, *polygonPairs[index].polyB)];
+		satCache.lastFrame = m_frame;
+		m_batchSatCaches[index] = &satCache;
+	}
+}
+
+void	CPhysicEngine::AddNarrowPhaseTasks(const std::vector<SPolygonPair>& pairs, SSatCache* const* satCaches, const SCollideEntry* entry, TBatchCollideFunction batchFunction, size_t taskSize)
+{
+	if (entry != nullptr && entry->function == nullptr)
+		return;
+
+	/** Batch kernels work on whole lane groups, keep the chunks a multiple of the lane count **/
+	if (batchFunction != nullptr)
+		taskSize = ((taskSize + SAT_BATCH_LANES - 1) / SAT_BATCH_LANES) * SAT_BATCH_LANES;
+
+	for (size_t begin = 0; begin < pairs.size(); begin += taskSize)
+	{
+		SNarrowPhaseTask task;
+		task.pairs = &pairs;
+		task.satCaches = satCaches;
+		task.entry = entry;
+		task.batchFunction = batchFunction;
+		task.begin = begin;
+		task.end = Min(begin + taskSize, pairs.size());
+		m_narrowPhaseTasks.push_back(task);
+	}
+}
+
+void	CPhysicEngine::CollidePairs(const SNarrowPhaseTask& task, std::vector<SCollision>& collisions) const
+{
+	const size_t firstCollision = collisions.size();
+
+	if (task.batchFunction != nullptr)
+	{
+		task.batchFunction(task.pairs->data() + task.begin, task.end - task.begin, collisions);
+	}
+	else
+	{
+		CollidePairsWithTable(task, collisions);
+	}
+
+	for (size_t index = firstCollision; index < collisions.size(); ++index)
+	{
+		GenerateManifold(collisions[index]);
+	}
+}
+
+void	CPhysicEngine::CollidePairsWithTable(const SNarrowPhaseTask& task, std::vector<SCollision>& collisions) const
+{
+	for (size_t index = task.begin; index < task.end; ++index)
+	{
+		const SPolygonPair& pair = (*task.pairs)[index];
+
 		SCollision collision;
 		collision.polyA = pair.polyA;
 		collision.polyB = pair.polyB;
 
-		if (pair.polyA->CheckCollision(*(pair.polyB), collision))
+		SSatCache* satCache = task.satCaches ? task.satCaches[index] : nullptr;
+
+		/** Kernels registered the other way around get the pair swapped, normal stays A toward B **/
+		bool colliding;
+		if (task.entry->swapped)
+		{
+			colliding = task.entry->function(*pair.polyB, *pair.polyA, collision, satCache);
+			collision.normal *= -1.0f;
+		}
+		else
+		{
+			colliding = task.entry->function(*pair.polyA, *pair.polyB, collision, satCache);
+		}
+
+		if (colliding)
+		{
+			collisions.push_back(collision);
+		}
+	}
+}
+
+bool	CPhysicEngine::UseThreadPool() const
+{
+	return gVars->pThreadPool && gVars->pThreadPool->GetThreadCount() > 1 && m_pairsToCheck.size() >= m_parallelNarrowPhaseThreshold;
+}
+
+void	CPhysicEngine::CollisionNarrowPhase()
+{
+	/** Whatever solved the last collisions left its accumulated impulses in their manifolds **/
+	m_contactCache.StoreImpulses(m_collidingPairs);
+
+	/** Sleeping pairs aren't tested again, their last collisions stay in front (and keep their cache entries), new ones go after **/
+	size_t sleepingCount = 0;
+	for (size_t index = 0; index < m_collidingPairs.size(); ++index)
+	{
+		if (!IsSleepingPair(*m_collidingPairs[index].polyA, *m_collidingPairs[index].polyB))
+			continue;
+
+		if (index != sleepingCount)
+			m_collidingPairs[sleepingCount] = std::move(m_collidingPairs[index]);
+		++sleepingCount;
+	}
+	m_collidingPairs.resize(sleepingCount);
+	++m_frame;
+
+	BatchPairs();
+
+	/** One task per batch when serial, fixed size chunks otherwise **/
+	const bool parallel = UseThreadPool();
+	const size_t taskSize = parallel ? m_narrowPhaseTaskSize : m_pairsToCheck.size() + 1;
+
+	m_narrowPhaseTasks.clear();
+	for (size_t typeA = 0; typeA < ShapeTypeCount; ++typeA)
+	{
+		for (size_t typeB = typeA; typeB < ShapeTypeCount; ++typeB)
 		{
-			m_collidingPairs.push_back(collision);
+			const bool polygons = (typeA == (size_t)ShapeType::Polygon && typeB == (size_t)ShapeType::Polygon);
+			AddNarrowPhaseTasks(m_pairBatches[typeA][typeB], polygons ? m_batchSatCaches.data() : nullptr, &m_collideFunctions[typeA][typeB], nullptr, taskSize);
 		}
 	}
+	AddNarrowPhaseTasks(m_satBatch, nullptr, nullptr, &SatBatchCollide, taskSize);
+	AddNarrowPhaseTasks(m_gjkBatch, nullptr, nullptr, &CollideGJKBatch, taskSize);
+
+	if (parallel)
+	{
+		if (m_narrowPhaseBuffers.size() < m_narrowPhaseTasks.size())
+			m_narrowPhaseBuffers.resize(m_narrowPhaseTasks.size());
+
+		/** Kernels only read the world caches refreshed in Step() and write their own SAT cache entry **/
+		gVars->pThreadPool->ParallelFor(m_narrowPhaseTasks.size(), [this](size_t taskIndex)
+		{
+			std::vector<SCollision>& collisions = m_narrowPhaseBuffers[taskIndex];
+			collisions.clear();
+			CollidePairs(m_narrowPhaseTasks[taskIndex], collisions);
+		});
+
+		size_t collisionCount = 0;
+		for (size_t taskIndex = 0; taskIndex < m_narrowPhaseTasks.size(); ++taskIndex)
+			collisionCount += m_narrowPhaseBuffers[taskIndex].size();
+
+		m_collidingPairs.reserve(m_collidingPairs.size() + collisionCount);
+		for (size_t taskIndex = 0; taskIndex < m_narrowPhaseTasks.size(); ++taskIndex)
+		{
+			const std::vector<SCollision>& collisions = m_narrowPhaseBuffers[taskIndex];
+			m_collidingPairs.insert(m_collidingPairs.end(), collisions.begin(), collisions.end());
+		}
+	}
+	else
+	{
+		for (const SNarrowPhaseTask& task : m_narrowPhaseTasks)
+			CollidePairs(task, m_collidingPairs);
+	}
+
+	m_contactEvents.clear();
+	m_contactCache.Update(m_collidingPairs, m_contactEvents);
+
+	/** Drop the pairs the broadphase stopped reporting (or moved to GJK) once they outnumber the live ones **/
+	if (m_satCache.size() > 2 * m_pairsToCheck.size())
+	{
+		for (auto it = m_satCache.begin(); it != m_satCache.end();)
+		{
+			if (it->second.lastFrame != m_frame) it = m_satCache.erase(it);
+			else ++it;
+		}
+	}
+}
+
+uint64_t CPhysicEngine::GetPairKey(const CPolygon& polyA, const CPolygon& polyB)
+{
+	const uint64_t indexA = polyA.GetIndex();
+	const uint64_t indexB = polyB.GetIndex();
+	return (Min(indexA, indexB) << 32) | Max(indexA, indexB);
 }
\ No newline at end of file
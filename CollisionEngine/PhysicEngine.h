@@ -3,25 +3,116 @@
 
 #include <vector>
 #include <unordered_map>
+#include <functional>
 #include "Maths.h"
 #include "Polygon.h"
 #include "Collision.h"
+#include "ShapeCollision.h"
+#include "ContactCache.h"
+#include "ContactSolver.h"
+#include "Island.h"
 
 class IBroadPhase;
+struct AABB;
+
+enum class BroadPhaseType : int
+{
+	Brut = 0,
+	AABBTree,
+	SweepAndPrune,
+	HashGrid,
+
+	Count,
+};
+
+enum class NarrowPhaseType : int
+{
+	SAT = 0,
+	GJK,
+	Auto,	// GJK / EPA once a polygon of the pair has more vertices than the GJK threshold
+
+	Count,
+};
+
+struct STimeStepSettings
+{
+	float	fixedTimeStep = 1.0f / 120.0f;
+	size_t	subSteps = 1;			// Step() calls per fixed step, fixedTimeStep / subSteps each
+	size_t	maxStepsPerFrame = 8;	// time left after that many fixed steps is dropped, a slow frame doesn't snowball
+};
+
+struct SSleepSettings
+{
+	bool	enabled = true;
+	float	timeToSleep = 0.5f;			// every body of an island has to stay under the tolerances this long
+	float	linearTolerance = 0.05f;
+	float	angularTolerance = 0.035f;	// radians per second, about 2 degrees
+};
 
 class CPhysicEngine
 {
 public:
+	CPhysicEngine();
+
 	void	Reset();
 	void	Activate(bool active);
 
 	void	DetectCollisions();
 
+	// One step of deltaTime (at most 1/15 s), Update() calls it at the fixed rate
 	void	Step(float deltaTime);
 
+	// Runs the fixed steps that fit in the time accumulated with frameTime, the rest waits for the next frames
+	void	Update(float frameTime);
+	// Part of a fixed step accumulated since the last one, in [0, 1], to draw the bodies between their last two transforms
+	float	GetInterpolation() const;
+	// False during the steps of a frame before the last one, whose debug texts would only be drawn over
+	bool	IsDebugStep() const;
+
+	void						SetTimeStepSettings(const STimeStepSettings& settings);
+	const STimeStepSettings&	GetTimeStepSettings() const;
+
+	// Duration of the last simulated step, used to predict motion
+	float	GetTimeStep() const;
+
+	// Iteration counts and contact parameters, can change between two steps
+	void					SetSolverSettings(const SSolverSettings& settings);
+	const SSolverSettings&	GetSolverSettings() const;
+
+	// Disabling sleeping wakes every body
+	void					SetSleepSettings(const SSleepSettings& settings);
+	const SSleepSettings&	GetSleepSettings() const;
+
 	void InitBroadPhase();
 	IBroadPhase* GetBroadPhase() const;
 
+	// Takes effect on next Reset()
+	void			SetBroadPhaseType(BroadPhaseType type);
+	BroadPhaseType	GetBroadPhaseType() const;
+	const char*		GetBroadPhaseName() const;
+
+	void			SetNarrowPhaseType(NarrowPhaseType type);
+	NarrowPhaseType	GetNarrowPhaseType() const;
+	void			SetGJKVertexThreshold(size_t vertexCount);
+	// Overrides the narrowphase type for one pair, Auto goes back to the global setting
+	void			SetPairNarrowPhase(const CPolygon& polyA, const CPolygon& polyB, NarrowPhaseType type);
+	// Kernel for (typeA, typeB) pairs, also used for (typeB, typeA) pairs with A and B swapped and the normal flipped back
+	// Polygon / polygon pairs sent to GJK by the narrowphase type don't go through the registry
+	void			RegisterCollideFunction(ShapeType typeA, ShapeType typeB, TCollideFunction function);
+	// SAT pairs of triangles / quads go through the SoA batch kernel (see SatBatch.h) when built with SSE2, on by default
+	void			SetSatBatchEnabled(bool enabled);
+
+	// Spatial queries : broadphase candidates refined against the polygon shapes
+	// Callbacks return false to stop the query
+	void		QueryAABB(const AABB& aabb, const std::function<bool(const CPolygonPtr&)>& callback);
+	void		QueryPoint(const Vec2& point, const std::function<bool(const CPolygonPtr&)>& callback);
+	CPolygonPtr	QueryPoint(const Vec2& point);
+
+	// Closest hit on the segment from -> to
+	bool		RayCast(const Vec2& from, const Vec2& to, SRayCastHit& hit);
+	// Every hit in any order, callback returns 0 to stop, hit.fraction to only keep closer hits, 1 to go on
+	void		RayCast(const Vec2& from, const Vec2& to, const std::function<float(const SRayCastHit&)>& callback);
+
 	template<typename TFunctor>
 	void	ForEachCollision(TFunctor functor)
 	{
@@ -31,17 +122,119 @@ public:
 		}
 	}
 
+	// Begin / persist / end of the touching pairs for the last step, manifold impulses are warm started from the previous step
+	template<typename TFunctor>
+	void	ForEachContactEvent(TFunctor functor)
+	{
+		for (const SContactEvent& contactEvent : m_contactEvents)
+		{
+			functor(contactEvent);
+		}
+	}
+
 private:
 	void							CollisionBroadPhase();
 	void							CollisionNarrowPhase();
+	void							SolveContacts(float deltaTime);
+
+	// Islands touched by an awake body wake up before the solve, the ones that stayed slow long enough sleep after it
+	void							WakeIslands();
+	void							UpdateSleep(float deltaTime);
+	void							WakeAll();
+	// Neither body moves this step, the last collision of the pair still holds
+	bool							IsSleepingPair(const CPolygon& polyA, const CPolygon& polyB) const;
+	// Awake dynamic body, or static one moved by a tool or a scene since the last step
+	bool							IsMoving(const CPolygon& poly) const;
+	void							UpdateStaticTransform(const CPolygon& poly);
+	// Sleeping bodies touched by a moved static wake up, WakeIslands then wakes the rest of their island
+	bool							WakeTouchedByMovedStatics();
+
+	static IBroadPhase*				CreateBroadPhase(BroadPhaseType type);
+	bool							UseGJK(const CPolygon& polyA, const CPolygon& polyB) const;
+
+	void							BatchPairs();
+	bool							UseThreadPool() const;
 
 	bool							m_active = true;
+	float							m_timeStep = 1.0f / 60.0f;
+
+	STimeStepSettings				m_timeStepSettings;
+	float							m_accumulator = 0.0f;
 
 	// Collision detection
-	IBroadPhase*					m_broadPhase;
+	IBroadPhase*					m_broadPhase = nullptr;
+	BroadPhaseType					m_broadPhaseType = BroadPhaseType::AABBTree;
 	std::vector<SPolygonPair>		m_pairsToCheck;
 	std::vector<SCollision>			m_collidingPairs;
 
+	CContactCache					m_contactCache;
+	std::vector<SContactEvent>		m_contactEvents;
+
+	CContactSolver					m_contactSolver;
+	SSolverSettings					m_solverSettings;
+
+	CIslandGraph					m_islands;
+	SSleepSettings					m_sleepSettings;
+	size_t							m_awakeBodyCount = 0;
+	size_t							m_sleepingBodyCount = 0;
+
+	struct SStaticTransform
+	{
+		Vec2	position;
+		Mat2	rotation;
+		bool	valid = false;
+		bool	moved = false;
+	};
+	std::vector<SStaticTransform>	m_staticTransforms; // by polygon index
+	size_t							m_movedStaticCount = 0;
+
+	bool							m_drawDebug = true;
+
+	// Last SAT axis of every pair, keyed by (min index << 32 | max index)
+	static uint64_t					GetPairKey(const CPolygon& polyA, const CPolygon& polyB);
+	std::unordered_map<uint64_t, SSatCache>	m_satCache;
+
+	NarrowPhaseType					m_narrowPhaseType = NarrowPhaseType::Auto;
+	size_t							m_gjkVertexThreshold = 12;
+	std::unordered_map<uint64_t, NarrowPhaseType>	m_pairNarrowPhase;
+	uint32_t						m_frame = 0;
+
+	// Narrowphase dispatch, pairs are sorted into one batch per (typeA, typeA <= typeB) so each kernel runs on its own pairs
+	struct SCollideEntry
+	{
+		TCollideFunction	function = nullptr;
+		bool				swapped = false; // registered as (typeB, typeA)
+	};
+
+	static const size_t				ShapeTypeCount = (size_t)ShapeType::Count;
+	SCollideEntry					m_collideFunctions[ShapeTypeCount][ShapeTypeCount];
+	std::vector<SPolygonPair>		m_pairBatches[ShapeTypeCount][ShapeTypeCount];
+	std::vector<SPolygonPair>		m_gjkBatch;
+	std::vector<SPolygonPair>		m_satBatch;
+	bool							m_satBatchEnabled = true;
+	// SAT cache entry of every polygon / polygon batch pair, looked up before the kernels run since the map isn't thread safe
+	std::vector<SSatCache*>			m_batchSatCaches;
+
+	// Chunk of a batch, every task writes its own buffer and the buffers are appended in task order
+	struct SNarrowPhaseTask
+	{
+		const std::vector<SPolygonPair>*	pairs;
+		SSatCache* const*					satCaches;	// nullptr if the kernel doesn't use the cache
+		const SCollideEntry*				entry;		// nullptr for the batch kernels
+		TBatchCollideFunction				batchFunction;
+		size_t								begin;
+		size_t								end;
+	};
+	std::vector<SNarrowPhaseTask>			m_narrowPhaseTasks;
+	std::vector<std::vector<SCollision>>	m_narrowPhaseBuffers;
+	const size_t					m_parallelNarrowPhaseThreshold = 256;
+	const size_t					m_narrowPhaseTaskSize = 128;
+
+	void							AddNarrowPhaseTasks(const std::vector<SPolygonPair>& pairs, SSatCache* const* satCaches, const SCollideEntry* entry, TBatchCollideFunction batchFunction, size_t taskSize);
+	// Kernels of the task, then the manifold of every colliding pair
+	void							CollidePairs(const SNarrowPhaseTask& task, std::vector<SCollision>& collisions) const;
+	void							CollidePairsWithTable(const SNarrowPhaseTask& task, std::vector<SCollision>& collisions) const;
+
 };
 
 #endif
\ No newline at end of file
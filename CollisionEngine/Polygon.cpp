@@ -8,6 +8,7 @@
 #include "GlobalVariables.h"
 #include "Renderer.h"
 #include "Collision.h"
+#include "AABB.h"
 
 CPolygon::CPolygon(size_t index)
 	: m_vertexBufferId(0), m_index(index), density(0.1f)
@@ -23,27 +24,49 @@ void CPolygon::Build()
 {
 	m_lines.clear();
 
-	ComputeArea();
-	RecenterOnCenterOfMass();
-	ComputeLocalInertiaTensor();
+	if (shapeType == ShapeType::Polygon)
+	{
+		ComputeArea();
+		RecenterOnCenterOfMass();
+		ComputeLocalInertiaTensor();
+	}
+	else
+	{
+		ComputeRoundMassData();
+	}
 
 	CreateBuffers();
 	BuildLines();
+
+	m_worldCacheValid = false;
 }
 
-void CPolygon::Draw()
+void CPolygon::Draw(float interpolation)
 {
+	Vec2 drawPosition = position;
+	Mat2 drawRotation = rotation;
+
+	if (m_hasPreviousTransform && density != 0.0f && interpolation < 1.0f)
+	{
+		drawPosition = m_previousPosition + (position - m_previousPosition) * interpolation;
+
+		/** Shortest arc between both rotations **/
+		const float angle = atan2f(m_previousRotation.X ^ rotation.X, m_previousRotation.X | rotation.X);
+		drawRotation = m_previousRotation;
+		drawRotation.Rotate(RAD2DEG(angle * interpolation));
+	}
+
 	// Set transforms (qssuming model view mode is set)
-	float transfMat[16] = {	rotation.X.x, rotation.X.y, 0.0f, 0.0f,
-							rotation.Y.x, rotation.Y.y, 0.0f, 0.0f,
+	float transfMat[16] = {	drawRotation.X.x, drawRotation.X.y, 0.0f, 0.0f,
+							drawRotation.Y.x, drawRotation.Y.y, 0.0f, 0.0f,
 							0.0f, 0.0f, 0.0f, 1.0f,
-							position.x, position.y, -1.0f, 1.0f };
+							drawPosition.x, drawPosition.y, -1.0f, 1.0f };
 	glPushMatrix();
 	glMultMatrixf(transfMat);
 
 	// Draw vertices
 	BindBuffers();
-	glDrawArrays(GL_LINE_LOOP, 0, points.size());
+	glDrawArrays(GL_LINE_LOOP, 0, m_outlineCount);
 	glDisableClientState(GL_VERTEX_ARRAY);
 
 	glPopMatrix();
@@ -69,20 +92,224 @@ Vec2	CPolygon::InverseTransformPoint(const Vec2& point) const
 	return rotation.GetInverseOrtho() * (point - position);
 }
 
+const std::vector<Vec2>&	CPolygon::GetWorldPoints() const
+{
+	UpdateWorldCache();
+	return m_worldPoints;
+}
+
+const std::vector<Vec2>&	CPolygon::GetWorldNormals() const
+{
+	UpdateWorldCache();
+	return m_worldNormals;
+}
+
+void	CPolygon::UpdateWorldCache() const
+{
+	if (IsWorldCacheValid()) return;
+
+	const size_t size = points.size();
+	m_worldPoints.resize(size);
+
+	for (size_t index = 0; index < size; ++index)
+		m_worldPoints[index] = TransformPoint(points[index]);
+
+	/** Circles have no edge **/
+	m_worldNormals.resize(m_lines.size());
+	for (size_t index = 0; index < m_lines.size(); ++index)
+		m_worldNormals[index] = rotation * m_lines[index].GetNormal();
+
+	m_cachedPosition = position;
+	m_cachedRotation = rotation;
+	m_worldCacheValid = true;
+}
+
+bool	CPolygon::IsWorldCacheValid() const
+{
+	return m_worldCacheValid && position == m_cachedPosition && rotation.X == m_cachedRotation.X && rotation.Y == m_cachedRotation.Y;
+}
+
 bool	CPolygon::IsPointInside(const Vec2& point) const
 {
+	if (shapeType != ShapeType::Polygon)
+	{
+		const std::vector<Vec2>& corePoints = GetWorldPoints();
+		return (point - ClosestPointOnSegment(corePoints.front(), corePoints.back(), point)).GetSqrLength() <= radius * radius;
+	}
+
 	float maxDist = -FLT_MAX;
 
-	for (const Line& line : m_lines)
+	const std::vector<Vec2>& worldPoints = GetWorldPoints();
+	const std::vector<Vec2>& worldNormals = GetWorldNormals();
+
+	for (size_t index = 0; index < worldPoints.size(); ++index)
 	{
-		Line globalLine = line.Transform(rotation, position);
-		float pointDist = globalLine.GetPointDist(point);
+		float pointDist = (point - worldPoints[index]) | worldNormals[index];
 		maxDist = Max(maxDist, pointDist);
 	}
 
 	return maxDist <= 0.0f;
 }
 
+bool	CPolygon::RayCast(const Vec2& from, const Vec2& to, float maxFraction, float& fraction, Vec2& normal) const
+{
+	if (shapeType != ShapeType::Polygon)
+		return RayCastRound(from, to, maxFraction, fraction, normal);
+
+	/** Clip the local space segment by every edge half plane **/
+	const Vec2 localFrom = InverseTransformPoint(from);
+	const Vec2 localDelta = InverseTransformPoint(to) - localFrom;
+
+	float lower = 0.0f;
+	float upper = maxFraction;
+	int entryLine = -1;
+
+	for (size_t index = 0; index < m_lines.size(); ++index)
+	{
+		const Vec2 lineNormal = m_lines[index].GetNormal();
+		const float numerator = (m_lines[index].point - localFrom) | lineNormal;
+		const float denominator = lineNormal | localDelta;
+
+		if (denominator == 0.0f)
+		{
+			if (numerator < 0.0f)
+				return false;
+		}
+		else if (denominator < 0.0f && numerator < lower * denominator)
+		{
+			lower = numerator / denominator;
+			entryLine = (int)index;
+		}
+		else if (denominator > 0.0f && numerator < upper * denominator)
+		{
+			upper = numerator / denominator;
+		}
+
+		if (upper < lower)
+			return false;
+	}
+
+	if (entryLine < 0)
+		return false;
+
+	fraction = lower;
+	normal = rotation * m_lines[entryLine].GetNormal();
+	return true;
+}
+
+bool	CPolygon::RayCastRound(const Vec2& from, const Vec2& to, float maxFraction, float& fraction, Vec2& normal) const
+{
+	if (IsPointInside(from))
+		return false;
+
+	const std::vector<Vec2>& corePoints = GetWorldPoints();
+	const Vec2 delta = to - from;
+	const float sqrDelta = delta.GetSqrLength();
+	if (sqrDelta == 0.0f)
+		return false;
+
+	bool hit = false;
+	fraction = maxFraction;
+
+	/** Caps : first root of |from + delta * t - center| = radius **/
+	for (const Vec2& center : corePoints)
+	{
+		const Vec2 offset = from - center;
+		const float b = offset | delta;
+		const float c = offset.GetSqrLength() - radius * radius;
+		const float discriminant = b * b - sqrDelta * c;
+		if (discriminant < 0.0f) continue;
+
+		const float t = (-b - sqrtf(discriminant)) / sqrDelta;
+		if (t < 0.0f || t > fraction) continue;
+
+		fraction = t;
+		normal = (offset + delta * t) / radius;
+		hit = true;
+	}
+
+	if (shapeType != ShapeType::Capsule)
+		return hit;
+
+	/** Sides : core segment pushed out by radius on both sides **/
+	const Vec2 segment = corePoints[1] - corePoints[0];
+	const float sqrLength = segment.GetSqrLength();
+	const Vec2 sideNormal = segment.GetNormal().Normalized();
+
+	for (float side = -1.0f; side <= 1.0f; side += 2.0f)
+	{
+		const Vec2 outward = sideNormal * side;
+		const float denominator = outward | delta;
+		if (denominator >= 0.0f) continue;
+
+		const float t = ((corePoints[0] + outward * radius - from) | outward) / denominator;
+		if (t < 0.0f || t > fraction) continue;
+
+		const float along = ((from + delta * t) - corePoints[0]) | segment;
+		if (along < 0.0f || along > sqrLength) continue;
+
+		fraction = t;
+		normal = outward;
+		hit = true;
+	}
+
+	return hit;
+}
+
+bool	CPolygon::IsOverlappingAABBRound(const AABB& aabb) const
+{
+	const std::vector<Vec2>& corePoints = GetWorldPoints();
+	const Vec2& start = corePoints.front();
+	const Vec2& end = corePoints.back();
+
+	if (aabb.RayCast(start, end - start, 1.0f))
+		return true;
+
+	/** Core and box don't cross, their distance is reached at an end of the core or a corner of the box **/
+	float sqrDistance = FLT_MAX;
+	for (const Vec2& point : corePoints)
+	{
+		const Vec2 boxPoint(Clamp(point.x, aabb.minX, aabb.maxX), Clamp(point.y, aabb.minY, aabb.maxY));
+		sqrDistance = Min(sqrDistance, (point - boxPoint).GetSqrLength());
+	}
+
+	const Vec2 corners[4] = { Vec2(aabb.minX, aabb.minY), Vec2(aabb.maxX, aabb.minY), Vec2(aabb.maxX, aabb.maxY), Vec2(aabb.minX, aabb.maxY) };
+	for (const Vec2& corner : corners)
+		sqrDistance = Min(sqrDistance, (corner - ClosestPointOnSegment(start, end, corner)).GetSqrLength());
+
+	return sqrDistance <= radius * radius;
+}
+
+bool	CPolygon::IsOverlappingAABB(const AABB& aabb) const
+{
+	if (shapeType != ShapeType::Polygon)
+		return IsOverlappingAABBRound(aabb);
+
+	/** SAT with the box axes then the polygon edge normals **/
+	const SProjection projX = Project(Vec2(1.0f, 0.0f));
+	if (projX.maximum < aabb.minX || projX.minimum > aabb.maxX) return false;
+
+	const SProjection projY = Project(Vec2(0.0f, 1.0f));
+	if (projY.maximum < aabb.minY || projY.minimum > aabb.maxY) return false;
+
+	const Vec2 center((aabb.minX + aabb.maxX) * 0.5f, (aabb.minY + aabb.maxY) * 0.5f);
+	const Vec2 halfExtents((aabb.maxX - aabb.minX) * 0.5f, (aabb.maxY - aabb.minY) * 0.5f);
+
+	const std::vector<Vec2>& worldPoints = GetWorldPoints();
+	const std::vector<Vec2>& worldNormals = GetWorldNormals();
+
+	for (size_t index = 0; index < worldPoints.size(); ++index)
+	{
+		const Vec2& edgeNormal = worldNormals[index];
+		const float boxRadius = halfExtents.x * fabsf(edgeNormal.x) + halfExtents.y * fabsf(edgeNormal.y);
+
+		/** Polygon lies under each of its edges, the box is separated if all of it is above one **/
+		if (((center - worldPoints[index]) | edgeNormal) > boxRadius) return false;
+	}
+
+	return true;
+}
+
 bool	CPolygon::IsLineIntersectingPolygon(const Line& line, Vec2& colPoint, float& colDist) const
 {
 	//float dist = 0.0f;
@@ -113,41 +340,109 @@ bool	CPolygon::IsLineIntersectingPolygon(const Line& line, Vec2& colPoint, float
 	return (minDist <= 0.0f);
 }
 
-bool	CPolygon::CheckCollision(const CPolygon& poly, SCollision& collision) const
+bool	CPolygon::CheckCollision(const CPolygon& poly, SCollision& collision, SSatCache* cache) const
 {
 	collision.distance = FLT_MAX;
-	if (SatCollisionChecker(poly, collision.point, collision.normal, collision.distance, true))
-		return poly.SatCollisionChecker(*this, collision.point, collision.normal, collision.distance, false);
 
+	size_t bestEdge = SIZE_MAX;
+	bool bestOnThis = true;
+
+	/** Last frame axis first : still separating most of the time, otherwise a good first guess of the min overlap **/
+	if (cache && (cache->ownerIndex == m_index || cache->ownerIndex == poly.m_index))
+	{
+		const bool ownedByThis = (cache->ownerIndex == m_index);
+		const CPolygon& owner = ownedByThis ? *this : poly;
+		const CPolygon& other = ownedByThis ? poly : *this;
+
+		if (cache->edge < owner.points.size())
+		{
+			const Vec2& axis = owner.GetWorldNormals()[cache->edge];
+			float penetration;
+
+			if (!owner.GetAxisPenetration(other, axis, penetration))
+			{
+				cache->separated = true;
+				return false;
+			}
+
+			collision.distance = penetration;
+			collision.normal = axis;
+			bestEdge = cache->edge;
+			bestOnThis = ownedByThis;
+		}
+	}
+
+	/** colEdge is only written when an axis separates or improves on the current min overlap **/
+	bool colliding = true;
+	for (int side = 0; side < 2 && colliding; ++side)
+	{
+		const CPolygon& owner = (side == 0) ? *this : poly;
+		const CPolygon& other = (side == 0) ? poly : *this;
+
+		size_t edge = SIZE_MAX;
+		colliding = owner.SatCollisionChecker(other, collision.normal, collision.distance, edge);
+
+		if (edge != SIZE_MAX)
+		{
+			bestEdge = edge;
+			bestOnThis = (side == 0);
+		}
+	}
+
+	if (cache)
+	{
+		cache->ownerIndex = bestOnThis ? m_index : poly.m_index;
+		cache->edge = bestEdge;
+		cache->separated = !colliding;
+	}
+
+	if (!colliding)
+		return false;
+
+	/** Normal goes from this toward poly **/
+	if (((poly.position - position) | collision.normal) < 0.f)
+		collision.normal *= -1.f;
 
-	return false;
+	return true;
 }
 
-Vec2* CPolygon::GetSATAxis() const
+size_t CPolygon::GetSupportIndex(const Vec2& direction) const
 {
-	const size_t size = points.size();
-	Vec2* axis = new Vec2[size];
-	
-	for (size_t index = 0; index < size; ++index)
-		axis[index] = (TransformPoint(points[(index + 1) % size]) - TransformPoint(points[index])).GetNormal().Normalized();
+	const std::vector<Vec2>& worldPoints = GetWorldPoints();
 
-	return axis;
+	size_t bestIndex = 0;
+	float bestProjection = direction | worldPoints[0];
+
+	for (size_t index = 1; index < worldPoints.size(); ++index)
+	{
+		const float projection = direction | worldPoints[index];
+		if (projection > bestProjection)
+		{
+			bestProjection = projection;
+			bestIndex = index;
+		}
+	}
+
+	return bestIndex;
 }
 
 SProjection CPolygon::Project(const Vec2& axis) const
 {
-	float min = axis | TransformPoint(m_lines[0].point);
+	const std::vector<Vec2>& worldPoints = GetWorldPoints();
+
+	float min = axis | worldPoints[0];
 	float max = min;
 
-	size_t size = points.size();
+	size_t size = worldPoints.size();
 	for (size_t index = 0; index < size; ++index)
 	{
-		float projResult = axis | TransformPoint(m_lines[index].point);
+		float projResult = axis | worldPoints[index];
 		if (projResult < min) min = projResult;
 		if (projResult > max) max = projResult;
 	}
 
-	return SProjection(min, max);
+	/** Axis is unit length, round shapes stretch by radius both ways **/
+	return SProjection(min - radius, max + radius);
 }
 
 
@@ -175,28 +470,82 @@ Vec2 CPolygon::GetPointVelocity(const Vec2& point) const
 	return speed + (point - position).GetNormal() * angularVelocity;
 }
 
+void CPolygon::SetAwake(bool awake)
+{
+	m_awake = awake;
+	sleepTime = 0.0f;
+
+	if (!awake)
+	{
+		speed = Vec2();
+		angularVelocity = 0.0f;
+		forces = Vec2();
+		torques = 0.0f;
+	}
+}
+
+bool CPolygon::IsAwake() const
+{
+	return m_awake;
+}
+
+void CPolygon::SavePreviousTransform()
+{
+	m_previousPosition = position;
+	m_previousRotation = rotation;
+	m_hasPreviousTransform = true;
+}
+
 void CPolygon::CreateBuffers()
 {
 	DestroyBuffers();
 
-	float* vertices = new float[3 * points.size()];
-	for (size_t i = 0; i < points.size(); ++i)
+	std::vector<Vec2> outline;
+	BuildOutline(outline);
+	m_outlineCount = outline.size();
+
+	float* vertices = new float[3 * outline.size()];
+	for (size_t i = 0; i < outline.size(); ++i)
 	{
-		vertices[3 * i] = points[i].x;
-		vertices[3 * i + 1] = points[i].y;
+		vertices[3 * i] = outline[i].x;
+		vertices[3 * i + 1] = outline[i].y;
 		vertices[3 * i + 2] = 0.0f;
 	}
 
 	glGenBuffers(1, &m_vertexBufferId);
 
 	glBindBuffer(GL_ARRAY_BUFFER, m_vertexBufferId);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(float) * 3 * points.size(), vertices, GL_STATIC_DRAW);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(float) * 3 * outline.size(), vertices, GL_STATIC_DRAW);
 
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
 
 	delete[] vertices;
 }
 
+void CPolygon::BuildOutline(std::vector<Vec2>& outline) const
+{
+	if (shapeType == ShapeType::Polygon)
+	{
+		outline = points;
+		return;
+	}
+
+	/** Half circle around each core point, a full one for circles **/
+	const size_t arcSegments = 16;
+	const Vec2 coreDir = points.back() - points.front();
+	const float startAngle = (shapeType == ShapeType::Capsule) ? RAD2DEG(atan2f(coreDir.y, coreDir.x)) + 90.0f : 0.0f;
+	const float arcAngle = (shapeType == ShapeType::Capsule) ? 180.0f : 360.0f;
+
+	for (size_t pointIndex = 0; pointIndex < points.size(); ++pointIndex)
+	{
+		for (size_t segment = 0; segment <= arcSegments; ++segment)
+		{
+			const float angle = DEG2RAD(startAngle + pointIndex * 180.0f + arcAngle * segment / arcSegments);
+			outline.push_back(points[pointIndex] + Vec2(cosf(angle), sinf(angle)) * radius);
+		}
+	}
+}
+
 void CPolygon::BindBuffers()
 {
 	if (m_vertexBufferId != 0)
@@ -219,6 +568,9 @@ void CPolygon::DestroyBuffers()
 
 void CPolygon::BuildLines()
 {
+	/** A single point has no edge, a capsule gets both sides of its core segment **/
+	if (points.size() < 2) return;
+
 	for (size_t index = 0; index < points.size(); ++index)
 	{
 		const Vec2& pointA = points[index];
@@ -230,65 +582,48 @@ void CPolygon::BuildLines()
 	}
 }
 
-bool CPolygon::SatCollisionChecker(const CPolygon& poly, Vec2& colPoint, Vec2& colNormal, float& colDist, bool receiver) const
+bool CPolygon::SatCollisionChecker(const CPolygon& poly, Vec2& colNormal, float& colDist, size_t& colEdge) const
 {
-	Vec2* shape1Axies = GetSATAxis();
-	size_t size = points.size();
+	/** Edge normals of this polygon only, the caller runs it the other way around for the normals of poly **/
+	const std::vector<Vec2>& axes = GetWorldNormals();
 
-	for (size_t index = 0; index < size; ++index)
+	for (size_t index = 0; index < axes.size(); ++index)
 	{
-		//gVars->pRenderer->DrawLine(shape1Axies[index], shape1Axies[index]*2.f, 1.f, 0.f, 0.f);
-		Vec2 axis = shape1Axies[index];
-		SProjection shapeProj1 = Project(axis);
-		SProjection shapeProj2 = poly.Project(axis);
-
-		if (!shapeProj1.IsOverlaping(shapeProj2)) return false;
-
-		float tempPen = shapeProj1.GetOverlapValue(shapeProj2);
-
-		if (shapeProj1.IsContaining(shapeProj2) || shapeProj2.IsContaining(shapeProj1))
+		float tempPen;
+		if (!GetAxisPenetration(poly, axes[index], tempPen))
 		{
-			float containementMin = abs(shapeProj1.minimum - shapeProj2.minimum);
-			float containementMax = abs(shapeProj1.maximum - shapeProj2.maximum);
-
-			if (containementMin < containementMax) tempPen += containementMin;
-			else tempPen += containementMax;
+			colEdge = index;
+			return false;
 		}
 
 		if (tempPen > colDist) continue;
 		
 		colDist = tempPen;
-		colNormal = axis;
+		colNormal = axes[index];
+		colEdge = index;
 	}
-	
-	delete[] shape1Axies;
 
-	Vec2* shape2Axies = poly.GetSATAxis();
-	size = poly.points.size();
+	return true;
+}
 
-	for (size_t index = 0; index < size; ++index)
-	{
-		//gVars->pRenderer->DrawLine(shape2Axies[index], shape2Axies[index] * 5.f, 0.f, 0.f, 1.f);
-		Vec2 axis = shape2Axies[index];
-		SProjection shapeProj1 = Project(axis);
-		SProjection shapeProj2 = Project(axis);
+bool CPolygon::GetAxisPenetration(const CPolygon& poly, const Vec2& axis, float& penetration) const
+{
+	SProjection shapeProj1 = Project(axis);
+	SProjection shapeProj2 = poly.Project(axis);
 
-		if (!shapeProj1.IsOverlaping(shapeProj2)) return false;
+	if (!shapeProj1.IsOverlaping(shapeProj2)) return false;
 
-		float tempPen = shapeProj1.GetOverlapValue(shapeProj2);
+	penetration = shapeProj1.GetOverlapValue(shapeProj2);
 
-		if (tempPen > colDist) continue;
+	if (shapeProj1.IsContaining(shapeProj2) || shapeProj2.IsContaining(shapeProj1))
+	{
+		float containementMin = abs(shapeProj1.minimum - shapeProj2.minimum);
+		float containementMax = abs(shapeProj1.maximum - shapeProj2.maximum);
 
-		colDist = tempPen;
-		colNormal = axis;
+		if (containementMin < containementMax) penetration += containementMin;
+		else penetration += containementMax;
 	}
 
-	delete[] shape2Axies;
-
-	Vec2 dist = (position - poly.position).Normalized();
-	if ((dist | colNormal) < 0.f)
-		colNormal *= -1.f;
-
 	return true;
 }
 
@@ -324,6 +659,41 @@ void CPolygon::RecenterOnCenterOfMass()
 	position += centroid;
 }
 
+void CPolygon::ComputeRoundMassData()
+{
+	/** Center the core on the origin **/
+	Vec2 center;
+	for (const Vec2& point : points)
+		center += point;
+	center /= (float)points.size();
+
+	for (Vec2& point : points)
+		point -= center;
+	position += center;
+
+	const float sqrRadius = radius * radius;
+	const float circleArea = (float)M_PI * sqrRadius;
+
+	if (shapeType == ShapeType::Circle)
+	{
+		m_signedArea = circleArea;
+		m_localInertiaTensor = 0.5f * sqrRadius;
+		return;
+	}
+
+	/** Capsule : box of the core segment + two half discs pushed out of it **/
+	const float length = (points[1] - points[0]).GetLength();
+	const float halfLength = 0.5f * length;
+	const float boxArea = 2.0f * radius * length;
+	const float capCentroid = 4.0f * radius / (3.0f * (float)M_PI);
+
+	const float circleInertia = circleArea * (0.5f * sqrRadius + halfLength * halfLength + 2.0f * halfLength * capCentroid);
+	const float boxInertia = boxArea * (4.0f * sqrRadius + length * length) / 12.0f;
+
+	m_signedArea = circleArea + boxArea;
+	m_localInertiaTensor = (circleInertia + boxInertia) / m_signedArea;
+}
+
 void CPolygon::ComputeLocalInertiaTensor()
 {
 	m_localInertiaTensor = 0.0f;
@@ -9,6 +9,15 @@
 
 
 
+enum class ShapeType : int
+{
+	Polygon = 0,
+	Circle,		// points = { center }, radius
+	Capsule,	// points = both ends of the core segment, radius
+
+	Count,
+};
+
 class CPolygon
 {
 private:
@@ -23,8 +32,14 @@ public:
 	std::vector<Vec2>	points;
 	//AABB				aabb;
 
+	// Circles and capsules are their core points inflated by radius, set both before Build()
+	ShapeType			shapeType = ShapeType::Polygon;
+	float				radius = 0.0f;
+
 	void				Build();
-	void				Draw();
+	// interpolation blends the transform saved by SavePreviousTransform (0) with the current one (1),
+	// static and kinematic bodies (density 0) are moved by behaviors outside the steps and drawn where they are
+	void				Draw(float interpolation = 1.0f);
 	size_t				GetIndex() const;
 
 	float				GetArea() const;
@@ -32,15 +47,29 @@ public:
 	Vec2				TransformPoint(const Vec2& point) const;
 	Vec2				InverseTransformPoint(const Vec2& point) const;
 
+	// World space vertices and outward unit normals (normal i is the edge from point i to point i + 1),
+	// recomputed on access (or by UpdateWorldCache) when position or rotation changed since the last update
+	const std::vector<Vec2>&	GetWorldPoints() const;
+	const std::vector<Vec2>&	GetWorldNormals() const;
+	void				UpdateWorldCache() const;
+
 	// if point is outside then returned distance is negative (and doesn't make sense)
 	bool				IsPointInside(const Vec2& point) const;
 
+	// Segment from -> to clipped against the polygon, fraction along the segment and world normal of the entry edge, no hit if from is inside
+	bool				RayCast(const Vec2& from, const Vec2& to, float maxFraction, float& fraction, Vec2& normal) const;
+	bool				IsOverlappingAABB(const struct AABB& aabb) const;
+
 	// If line intersect polygon, colDist is the penetration distance, and colPoint most penetrating point of poly inside the line
 	bool				IsLineIntersectingPolygon(const Line& line, Vec2& colPoint, float& colDist) const;
-	bool				CheckCollision(const CPolygon& poly, struct SCollision& collision) const;
+	// cache, when given, is tested first and updated with the new separating / min overlap edge
+	bool				CheckCollision(const CPolygon& poly, struct SCollision& collision, struct SSatCache* cache = nullptr) const;
 	
-	Vec2*				GetSATAxis() const;
 	SProjection			Project(const Vec2& axis) const;
+	// Overlap of both projections on axis (radius included), false if separated
+	bool				GetAxisPenetration(const CPolygon& poly, const Vec2& axis, float& penetration) const;
+	// Index of the world vertex furthest along direction
+	size_t				GetSupportIndex(const Vec2& direction) const;
 
 
 	float				GetMass() const;
@@ -55,6 +84,15 @@ public:
 	Vec2				forces;
 	float				torques = 0.0f;
 
+	// Sleeping bodies are skipped by the integration, the broadphase refit, the narrowphase and the solver until their island wakes up.
+	// Wake a body moved or pushed from outside the engine, its AABB isn't refit while it sleeps
+	void				SetAwake(bool awake);
+	bool				IsAwake() const;
+	float				sleepTime = 0.0f;	// time spent under the sleep velocity tolerances
+
+	// Transform before the last fixed step, for the render interpolation
+	void				SavePreviousTransform();
+
 
 private:
 	void				CreateBuffers();
@@ -62,22 +100,43 @@ private:
 	void				DestroyBuffers();
 
 	void				BuildLines();
+	void				BuildOutline(std::vector<Vec2>& outline) const;
+
+	bool				RayCastRound(const Vec2& from, const Vec2& to, float maxFraction, float& fraction, Vec2& normal) const;
+	bool				IsOverlappingAABBRound(const struct AABB& aabb) const;
 
-	bool				SatCollisionChecker(const CPolygon& poly, Vec2& colPoint, Vec2& colNormal, float& colDist, bool receiver) const;
+	// SAT on the edge normals of this polygon, keeps the smallest overlap in colNormal / colDist / colEdge, or returns false with the separating edge in colEdge
+	bool				SatCollisionChecker(const CPolygon& poly, Vec2& colNormal, float& colDist, size_t& colEdge) const;
 
 	void				ComputeArea();
 	void				RecenterOnCenterOfMass(); // Area must be computed
 	void				ComputeLocalInertiaTensor(); // Must be centered on center of mass
+	void				ComputeRoundMassData(); // Circle and capsule area, centering and inertia in closed form
 
 	GLuint				m_vertexBufferId;
+	size_t				m_outlineCount = 0;
 	size_t				m_index;
 
 	std::vector<Line>	m_lines;
 
+	// World space cache, see GetWorldPoints()
+	bool				IsWorldCacheValid() const;
+
+	mutable std::vector<Vec2>	m_worldPoints;
+	mutable std::vector<Vec2>	m_worldNormals;
+	mutable Vec2		m_cachedPosition;
+	mutable Mat2		m_cachedRotation;
+	mutable bool		m_worldCacheValid = false;
+
 	float				m_signedArea;
 
 	// Physics
 	float				m_localInertiaTensor; // don't consider mass
+	bool				m_awake = true;
+
+	Vec2				m_previousPosition;
+	Mat2				m_previousRotation;
+	bool				m_hasPreviousTransform = false; // bodies added since the last step are drawn where they are
 };
 
 typedef std::shared_ptr<CPolygon>	CPolygonPtr;
@@ -126,7 +126,7 @@ void CRenderer::Update()
 	DrawFPS(frameTime);
 
 
-	gVars->pPhysicEngine->Step(frameTime);
+	gVars->pPhysicEngine->Update(frameTime);
 	
 	timer.Start();
 	UpdateWorld(frameTime);
@@ -206,7 +206,7 @@ void  CRenderer::RenderPolygons()
 
 	if (gVars->pWorld)
 	{
-		gVars->pWorld->RenderPolygons();
+		gVars->pWorld->RenderPolygons(gVars->pPhysicEngine->GetInterpolation());
 		RenderGizmos();
 	}
 
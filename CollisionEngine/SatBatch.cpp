@@ -0,0 +1,226 @@
+#include "SatBatch.h"
+
+#include "Polygon.h"
+#include "Collision.h"
+
+#include <cfloat>
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define SAT_BATCH_SSE
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+	const size_t SAT_BATCH_AXES = 2 * SAT_BATCH_MAX_POINTS;
+
+	/** One group of lanes : vertices and axes of both polygons, [index][lane] **/
+	struct SSatBatchGroup
+	{
+		float	pointsAX[SAT_BATCH_MAX_POINTS][SAT_BATCH_LANES];
+		float	pointsAY[SAT_BATCH_MAX_POINTS][SAT_BATCH_LANES];
+		float	pointsBX[SAT_BATCH_MAX_POINTS][SAT_BATCH_LANES];
+		float	pointsBY[SAT_BATCH_MAX_POINTS][SAT_BATCH_LANES];
+		float	axesX[SAT_BATCH_AXES][SAT_BATCH_LANES];
+		float	axesY[SAT_BATCH_AXES][SAT_BATCH_LANES];
+
+		/** Results **/
+		float	penetration[SAT_BATCH_LANES];
+		float	normalX[SAT_BATCH_LANES];
+		float	normalY[SAT_BATCH_LANES];
+		int		colliding[SAT_BATCH_LANES];
+	};
+
+	/** Triangles repeat their last vertex and normal, that changes neither the projections nor the min overlap axis **/
+	void	GatherLane(SSatBatchGroup& group, size_t lane, const CPolygon& polyA, const CPolygon& polyB)
+	{
+		const std::vector<Vec2>& pointsA = polyA.GetWorldPoints();
+		const std::vector<Vec2>& pointsB = polyB.GetWorldPoints();
+		const std::vector<Vec2>& normalsA = polyA.GetWorldNormals();
+		const std::vector<Vec2>& normalsB = polyB.GetWorldNormals();
+
+		for (size_t index = 0; index < SAT_BATCH_MAX_POINTS; ++index)
+		{
+			const Vec2& pointA = pointsA[Min(index, pointsA.size() - 1)];
+			const Vec2& pointB = pointsB[Min(index, pointsB.size() - 1)];
+			const Vec2& normalA = normalsA[Min(index, normalsA.size() - 1)];
+			const Vec2& normalB = normalsB[Min(index, normalsB.size() - 1)];
+
+			group.pointsAX[index][lane] = pointA.x;
+			group.pointsAY[index][lane] = pointA.y;
+			group.pointsBX[index][lane] = pointB.x;
+			group.pointsBY[index][lane] = pointB.y;
+			group.axesX[index][lane] = normalA.x;
+			group.axesY[index][lane] = normalA.y;
+			group.axesX[SAT_BATCH_MAX_POINTS + index][lane] = normalB.x;
+			group.axesY[SAT_BATCH_MAX_POINTS + index][lane] = normalB.y;
+		}
+	}
+
+#ifdef SAT_BATCH_SSE
+	inline __m128	Select(__m128 mask, __m128 ifTrue, __m128 ifFalse)
+	{
+		return _mm_or_ps(_mm_and_ps(mask, ifTrue), _mm_andnot_ps(mask, ifFalse));
+	}
+
+	inline __m128	Abs(__m128 value)
+	{
+		return _mm_andnot_ps(_mm_set1_ps(-0.0f), value);
+	}
+
+	/** Same steps as CPolygon::GetAxisPenetration on 4 lanes, later axes win ties like SatCollisionChecker **/
+	void	CollideGroup(SSatBatchGroup& group)
+	{
+		__m128 bestPenetration = _mm_set1_ps(FLT_MAX);
+		__m128 bestX = _mm_setzero_ps();
+		__m128 bestY = _mm_setzero_ps();
+		__m128 separated = _mm_setzero_ps();
+
+		for (size_t axis = 0; axis < SAT_BATCH_AXES; ++axis)
+		{
+			const __m128 axisX = _mm_loadu_ps(group.axesX[axis]);
+			const __m128 axisY = _mm_loadu_ps(group.axesY[axis]);
+
+			__m128 minA = _mm_set1_ps(FLT_MAX), maxA = _mm_set1_ps(-FLT_MAX);
+			__m128 minB = _mm_set1_ps(FLT_MAX), maxB = _mm_set1_ps(-FLT_MAX);
+			for (size_t index = 0; index < SAT_BATCH_MAX_POINTS; ++index)
+			{
+				const __m128 dotA = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(group.pointsAX[index]), axisX), _mm_mul_ps(_mm_loadu_ps(group.pointsAY[index]), axisY));
+				const __m128 dotB = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(group.pointsBX[index]), axisX), _mm_mul_ps(_mm_loadu_ps(group.pointsBY[index]), axisY));
+				minA = _mm_min_ps(minA, dotA);
+				maxA = _mm_max_ps(maxA, dotA);
+				minB = _mm_min_ps(minB, dotB);
+				maxB = _mm_max_ps(maxB, dotB);
+			}
+
+			const __m128 overlapping = _mm_and_ps(_mm_cmplt_ps(minB, maxA), _mm_cmpgt_ps(maxB, minA));
+			separated = _mm_or_ps(separated, _mm_andnot_ps(overlapping, _mm_castsi128_ps(_mm_set1_epi32(-1))));
+
+			/** Most broadphase pairs are separated, stop once every lane found its axis **/
+			if (_mm_movemask_ps(separated) == 0xF)
+				break;
+
+			__m128 penetration = _mm_sub_ps(_mm_min_ps(maxA, maxB), _mm_max_ps(minA, minB));
+
+			const __m128 containing = _mm_or_ps(
+				_mm_and_ps(_mm_cmplt_ps(minA, minB), _mm_cmpgt_ps(maxA, maxB)),
+				_mm_and_ps(_mm_cmpgt_ps(minA, minB), _mm_cmplt_ps(maxA, maxB)));
+			const __m128 containment = _mm_min_ps(Abs(_mm_sub_ps(minA, minB)), Abs(_mm_sub_ps(maxA, maxB)));
+			penetration = _mm_add_ps(penetration, _mm_and_ps(containing, containment));
+
+			const __m128 better = _mm_cmple_ps(penetration, bestPenetration);
+			bestPenetration = Select(better, penetration, bestPenetration);
+			bestX = Select(better, axisX, bestX);
+			bestY = Select(better, axisY, bestY);
+		}
+
+		_mm_storeu_ps(group.penetration, bestPenetration);
+		_mm_storeu_ps(group.normalX, bestX);
+		_mm_storeu_ps(group.normalY, bestY);
+
+		const int separatedMask = _mm_movemask_ps(separated);
+		for (size_t lane = 0; lane < SAT_BATCH_LANES; ++lane)
+			group.colliding[lane] = ((separatedMask >> lane) & 1) == 0;
+	}
+#else
+	/** Scalar fallback, same loop order as the SSE version **/
+	void	CollideGroup(SSatBatchGroup& group)
+	{
+		for (size_t lane = 0; lane < SAT_BATCH_LANES; ++lane)
+		{
+			float bestPenetration = FLT_MAX;
+			float bestX = 0.0f, bestY = 0.0f;
+			bool separated = false;
+
+			for (size_t axis = 0; axis < SAT_BATCH_AXES; ++axis)
+			{
+				const float axisX = group.axesX[axis][lane];
+				const float axisY = group.axesY[axis][lane];
+
+				float minA = FLT_MAX, maxA = -FLT_MAX, minB = FLT_MAX, maxB = -FLT_MAX;
+				for (size_t index = 0; index < SAT_BATCH_MAX_POINTS; ++index)
+				{
+					const float dotA = group.pointsAX[index][lane] * axisX + group.pointsAY[index][lane] * axisY;
+					const float dotB = group.pointsBX[index][lane] * axisX + group.pointsBY[index][lane] * axisY;
+					minA = Min(minA, dotA);
+					maxA = Max(maxA, dotA);
+					minB = Min(minB, dotB);
+					maxB = Max(maxB, dotB);
+				}
+
+				separated |= !(minB < maxA && maxB > minA);
+				if (separated)
+					break;
+
+				float penetration = Min(maxA, maxB) - Max(minA, minB);
+				if ((minA < minB && maxA > maxB) || (minA > minB && maxA < maxB))
+					penetration += Min(fabsf(minA - minB), fabsf(maxA - maxB));
+
+				if (penetration <= bestPenetration)
+				{
+					bestPenetration = penetration;
+					bestX = axisX;
+					bestY = axisY;
+				}
+			}
+
+			group.penetration[lane] = bestPenetration;
+			group.normalX[lane] = bestX;
+			group.normalY[lane] = bestY;
+			group.colliding[lane] = !separated;
+		}
+	}
+#endif
+}
+
+bool	IsSatBatchCandidate(const CPolygon& poly)
+{
+	return poly.shapeType == ShapeType::Polygon && poly.points.size() >= 3 && poly.points.size() <= SAT_BATCH_MAX_POINTS;
+}
+
+bool	IsSatBatchSimd()
+{
+#ifdef SAT_BATCH_SSE
+	return true;
+#else
+	return false;
+#endif
+}
+
+void	SatBatchCollide(const SPolygonPair* pairs, size_t count, std::vector<SCollision>& collisions)
+{
+	SSatBatchGroup group;
+
+	for (size_t first = 0; first < count; first += SAT_BATCH_LANES)
+	{
+		/** The last group repeats its first pair in the unused lanes **/
+		const size_t laneCount = Min(SAT_BATCH_LANES, count - first);
+		for (size_t lane = 0; lane < SAT_BATCH_LANES; ++lane)
+		{
+			const SPolygonPair& pair = pairs[first + ((lane < laneCount) ? lane : 0)];
+			GatherLane(group, lane, *pair.polyA, *pair.polyB);
+		}
+
+		CollideGroup(group);
+
+		for (size_t lane = 0; lane < laneCount; ++lane)
+		{
+			if (!group.colliding[lane])
+				continue;
+
+			const SPolygonPair& pair = pairs[first + lane];
+
+			SCollision collision;
+			collision.polyA = pair.polyA;
+			collision.polyB = pair.polyB;
+			collision.normal = Vec2(group.normalX[lane], group.normalY[lane]);
+			collision.distance = group.penetration[lane];
+
+			/** Normal goes from A toward B **/
+			if (((pair.polyB->position - pair.polyA->position) | collision.normal) < 0.f)
+				collision.normal *= -1.f;
+
+			collisions.push_back(collision);
+		}
+	}
+}
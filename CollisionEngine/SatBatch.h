@@ -0,0 +1,23 @@
+#ifndef _SAT_BATCH_H_
+#define _SAT_BATCH_H_
+
+#include <vector>
+
+class CPolygon;
+struct SPolygonPair;
+struct SCollision;
+
+// Vertex count up to which polygons go through the batch kernel (triangles and quads)
+const size_t SAT_BATCH_MAX_POINTS = 4;
+// Pairs evaluated together, one per SIMD lane
+const size_t SAT_BATCH_LANES = 4;
+
+bool	IsSatBatchCandidate(const CPolygon& poly);
+// True when compiled with SSE2, the batch kernel runs the same SoA code lane by lane otherwise
+bool	IsSatBatchSimd();
+
+// SAT of count candidate pairs, SAT_BATCH_LANES pairs at a time in structure of arrays layout.
+// Same output as CPolygon::CheckCollision without cache, colliding pairs are appended to collisions in pair order
+void	SatBatchCollide(const SPolygonPair* pairs, size_t count, std::vector<SCollision>& collisions);
+
+#endif
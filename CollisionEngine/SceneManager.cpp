@@ -52,7 +52,7 @@ void CSceneManager::ReloadScene()
 
 void CSceneManager::CheckSceneUpdate()
 {
-	gVars->pRenderer->DisplayText("F1: Reset scene, F2: prev scene, F3: next scene, cur scene: " + std::to_string(m_currentScene) + ", F4: debug, F5: lock FPS");
+	gVars->pRenderer->DisplayText("F1: Reset scene, F2: prev scene, F3: next scene, cur scene: " + std::to_string(m_currentScene) + ", F4: debug, F5: lock FPS, F6: broadphase, F7/F8: solver iterations");
 
 	if (gVars->pRenderWindow->JustPressedKey(Key::F2) && m_currentScene > 0)
 	{
@@ -66,4 +66,20 @@ void CSceneManager::CheckSceneUpdate()
 	{
 		ReloadScene();
 	}
+	else if (gVars->pRenderWindow->JustPressedKey(Key::F6))
+	{
+		BroadPhaseType nextType = (BroadPhaseType)(((int)gVars->pPhysicEngine->GetBroadPhaseType() + 1) % (int)BroadPhaseType::Count);
+		gVars->pPhysicEngine->SetBroadPhaseType(nextType);
+		ReloadScene();
+	}
+	else if (gVars->pRenderWindow->JustPressedKey(Key::F7) || gVars->pRenderWindow->JustPressedKey(Key::F8))
+	{
+		/** Fewer iterations trade stack stability for frame time **/
+		SSolverSettings settings = gVars->pPhysicEngine->GetSolverSettings();
+		if (gVars->pRenderWindow->JustPressedKey(Key::F7))
+			settings.velocityIterations = Max(settings.velocityIterations, (size_t)2) - 1;
+		else
+			settings.velocityIterations += 1;
+		gVars->pPhysicEngine->SetSolverSettings(settings);
+	}
 }
\ No newline at end of file
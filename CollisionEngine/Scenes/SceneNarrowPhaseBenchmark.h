@@ -0,0 +1,47 @@
+#ifndef _SCENE_NARROW_PHASE_BENCHMARK_H_
+#define _SCENE_NARROW_PHASE_BENCHMARK_H_
+
+#include "BaseScene.h"
+
+#include "Behaviors/NarrowPhaseBenchmark.h"
+
+class CSceneNarrowPhaseBenchmark : public CBaseScene
+{
+public:
+	CSceneNarrowPhaseBenchmark(size_t polyCount)
+		: m_polyCount(polyCount){}
+
+protected:
+	virtual void Create() override
+	{
+		CBaseScene::Create();
+
+		gVars->pWorld->AddBehavior<CNarrowPhaseBenchmark>(nullptr);
+
+		float width = gVars->pRenderer->GetWorldWidth();
+		float height = gVars->pRenderer->GetWorldHeight();
+
+		/** Static triangles and quads, packed enough for most boxes to overlap **/
+		SRandomPolyParams params;
+		params.minRadius = 0.5f;
+		params.maxRadius = 1.0f;
+		params.minBounds = Vec2(-width * 0.45f, -height * 0.45f);
+		params.maxBounds = params.minBounds * -1.0f;
+		params.minPoints = 3;
+		params.maxPoints = 4;
+		params.minSpeed = 0.0f;
+		params.maxSpeed = 0.0f;
+
+		for (size_t i = 0; i < m_polyCount; ++i)
+		{
+			CPolygonPtr poly = gVars->pWorld->AddRandomPoly(params);
+			poly->density = 0.0f;
+			poly->rotation.SetAngle(Random(0.0f, 360.0f));
+		}
+	}
+
+private:
+	size_t m_polyCount;
+};
+
+#endif
@@ -0,0 +1,225 @@
+#include "ShapeCollision.h"
+#include "Polygon.h"
+#include "Collision.h"
+
+#include <cfloat>
+
+namespace
+{
+	/** Closest points between segments p1q1 and p2q2 (Ericson, Real-Time Collision Detection 5.1.9), degenerate segments allowed **/
+	void	ClosestPointsSegments(const Vec2& p1, const Vec2& q1, const Vec2& p2, const Vec2& q2, Vec2& c1, Vec2& c2)
+	{
+		const Vec2 d1 = q1 - p1;
+		const Vec2 d2 = q2 - p2;
+		const Vec2 r = p1 - p2;
+		const float a = d1 | d1;
+		const float e = d2 | d2;
+		const float f = d2 | r;
+
+		float s = 0.0f;
+		float t = 0.0f;
+
+		if (a <= FLT_EPSILON && e <= FLT_EPSILON)
+		{
+			c1 = p1;
+			c2 = p2;
+			return;
+		}
+
+		if (a <= FLT_EPSILON)
+		{
+			t = Clamp(f / e, 0.0f, 1.0f);
+		}
+		else
+		{
+			const float c = d1 | r;
+			if (e <= FLT_EPSILON)
+			{
+				s = Clamp(-c / a, 0.0f, 1.0f);
+			}
+			else
+			{
+				const float b = d1 | d2;
+				const float denominator = a * e - b * b;
+
+				s = (denominator != 0.0f) ? Clamp((b * f - c * e) / denominator, 0.0f, 1.0f) : 0.0f;
+				t = (b * s + f) / e;
+
+				if (t < 0.0f)
+				{
+					t = 0.0f;
+					s = Clamp(-c / a, 0.0f, 1.0f);
+				}
+				else if (t > 1.0f)
+				{
+					t = 1.0f;
+					s = Clamp((b - c) / a, 0.0f, 1.0f);
+				}
+			}
+		}
+
+		c1 = p1 + d1 * s;
+		c2 = p2 + d2 * t;
+	}
+
+	/** Contact between two closest points of cores inflated by radiusA and radiusB, direction from A toward B **/
+	bool	CollideCores(const Vec2& coreA, float radiusA, const Vec2& coreB, float radiusB, const Vec2& fallbackNormal, SCollision& collision)
+	{
+		const Vec2 delta = coreB - coreA;
+		const float sqrDistance = delta.GetSqrLength();
+		const float totalRadius = radiusA + radiusB;
+		if (sqrDistance > totalRadius * totalRadius)
+			return false;
+
+		const float distance = sqrtf(sqrDistance);
+		collision.normal = (distance > FLT_EPSILON) ? delta / distance : fallbackNormal;
+		collision.distance = totalRadius - distance;
+		collision.point = coreA + collision.normal * (radiusA - 0.5f * collision.distance);
+		return true;
+	}
+}
+
+bool	CollideRoundShapes(const CPolygon& shapeA, const CPolygon& shapeB, SCollision& collision)
+{
+	const std::vector<Vec2>& coreA = shapeA.GetWorldPoints();
+	const std::vector<Vec2>& coreB = shapeB.GetWorldPoints();
+
+	/** Circles are one point cores, the segment case covers every mix **/
+	Vec2 closestA, closestB;
+	ClosestPointsSegments(coreA.front(), coreA.back(), coreB.front(), coreB.back(), closestA, closestB);
+
+	const Vec2 centers = shapeB.position - shapeA.position;
+	const Vec2 fallbackNormal = (centers.GetSqrLength() > FLT_EPSILON) ? centers.Normalized() : Vec2(0.0f, 1.0f);
+	if ((closestB - closestA).GetSqrLength() > FLT_EPSILON)
+		return CollideCores(closestA, shapeA.radius, closestB, shapeB.radius, fallbackNormal, collision);
+
+	/** Crossing cores : the segments Minkowski difference is a parallelogram, SAT on the core normals gives the exact depth **/
+	collision.normal = fallbackNormal;
+	collision.distance = shapeA.radius + shapeB.radius;
+	bool hasAxis = false;
+
+	for (const CPolygon* shape : { &shapeA, &shapeB })
+	{
+		for (const Vec2& axis : shape->GetWorldNormals())
+		{
+			float penetration;
+			shapeA.GetAxisPenetration(shapeB, axis, penetration);
+			if (!hasAxis || penetration < collision.distance)
+			{
+				collision.distance = penetration;
+				collision.normal = axis;
+				hasAxis = true;
+			}
+		}
+	}
+
+	if ((centers | collision.normal) < 0.0f)
+		collision.normal *= -1.0f;
+
+	collision.point = closestA;
+	return true;
+}
+
+bool	CollidePolygonCircle(const CPolygon& poly, const CPolygon& circle, SCollision& collision)
+{
+	const std::vector<Vec2>& worldPoints = poly.GetWorldPoints();
+	const std::vector<Vec2>& worldNormals = poly.GetWorldNormals();
+	const Vec2 center = circle.GetWorldPoints()[0];
+	const size_t count = worldPoints.size();
+
+	/** Edge of max separation, normal i is the edge from point i to point i + 1 **/
+	size_t bestEdge = 0;
+	float separation = -FLT_MAX;
+	for (size_t index = 0; index < count; ++index)
+	{
+		const float edgeSeparation = (center - worldPoints[index]) | worldNormals[index];
+		if (edgeSeparation > circle.radius)
+			return false;
+
+		if (edgeSeparation > separation)
+		{
+			separation = edgeSeparation;
+			bestEdge = index;
+		}
+	}
+
+	const Vec2& vertex1 = worldPoints[bestEdge];
+	const Vec2& vertex2 = worldPoints[(bestEdge + 1) % count];
+
+	/** Center inside : push out through the closest face **/
+	if (separation < FLT_EPSILON)
+	{
+		collision.normal = worldNormals[bestEdge];
+		collision.distance = circle.radius - separation;
+		collision.point = center - collision.normal * circle.radius;
+		return true;
+	}
+
+	/** Vertex regions of the face, then the face itself **/
+	if (((center - vertex1) | (vertex2 - vertex1)) <= 0.0f)
+		return CollideCores(vertex1, 0.0f, center, circle.radius, worldNormals[bestEdge], collision);
+
+	if (((center - vertex2) | (vertex1 - vertex2)) <= 0.0f)
+		return CollideCores(vertex2, 0.0f, center, circle.radius, worldNormals[bestEdge], collision);
+
+	collision.normal = worldNormals[bestEdge];
+	collision.distance = circle.radius - separation;
+	collision.point = center - collision.normal * circle.radius;
+	return true;
+}
+
+bool	CollidePolygonCapsule(const CPolygon& poly, const CPolygon& capsule, SCollision& collision)
+{
+	const std::vector<Vec2>& worldPoints = poly.GetWorldPoints();
+	const Vec2& coreStart = capsule.GetWorldPoints()[0];
+	const Vec2& coreEnd = capsule.GetWorldPoints()[1];
+	const size_t count = worldPoints.size();
+
+	/** Closest features of the polygon boundary and the core segment **/
+	float bestSqrDistance = FLT_MAX;
+	Vec2 bestPoly, bestCore;
+	for (size_t index = 0; index < count; ++index)
+	{
+		Vec2 closestPoly, closestCore;
+		ClosestPointsSegments(worldPoints[index], worldPoints[(index + 1) % count], coreStart, coreEnd, closestPoly, closestCore);
+
+		const float sqrDistance = (closestCore - closestPoly).GetSqrLength();
+		if (sqrDistance < bestSqrDistance)
+		{
+			bestSqrDistance = sqrDistance;
+			bestPoly = closestPoly;
+			bestCore = closestCore;
+		}
+	}
+
+	const bool coreInside = poly.IsPointInside(coreStart);
+	if (!coreInside && bestSqrDistance > FLT_EPSILON)
+		return CollideCores(bestPoly, 0.0f, bestCore, capsule.radius, Vec2(0.0f, 1.0f), collision);
+
+	/** Core crosses the polygon : SAT on the polygon normals and the core normal, projections include the radius **/
+	collision.distance = FLT_MAX;
+	const std::vector<Vec2>& polyNormals = poly.GetWorldNormals();
+	const std::vector<Vec2>& capsuleNormals = capsule.GetWorldNormals();
+
+	for (const std::vector<Vec2>* axes : { &polyNormals, &capsuleNormals })
+	{
+		for (const Vec2& axis : *axes)
+		{
+			float penetration;
+			if (!poly.GetAxisPenetration(capsule, axis, penetration))
+				return false;
+
+			if (penetration < collision.distance)
+			{
+				collision.distance = penetration;
+				collision.normal = axis;
+			}
+		}
+	}
+
+	if (((capsule.position - poly.position) | collision.normal) < 0.0f)
+		collision.normal *= -1.0f;
+
+	collision.point = capsule.GetWorldPoints()[capsule.GetSupportIndex(collision.normal * -1.0f)] - collision.normal * capsule.radius;
+	return true;
+}
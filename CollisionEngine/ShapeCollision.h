@@ -0,0 +1,20 @@
+#ifndef _SHAPE_COLLISION_H_
+#define _SHAPE_COLLISION_H_
+
+#include <vector>
+
+class CPolygon;
+struct SCollision;
+struct SSatCache;
+
+// Narrowphase kernel registered in CPhysicEngine per shape type pair, cache is only given for polygon / polygon pairs
+typedef bool (*TCollideFunction)(const CPolygon& shapeA, const CPolygon& shapeB, SCollision& collision, SSatCache* cache);
+// Kernel working on a whole range of pairs at once, colliding pairs are appended in pair order
+typedef void (*TBatchCollideFunction)(const struct SPolygonPair* pairs, size_t count, std::vector<SCollision>& collisions);
+
+// Closed form kernels for circles and capsules, same output as CPolygon::CheckCollision : normal from A toward B, distance = penetration
+bool	CollideRoundShapes(const CPolygon& shapeA, const CPolygon& shapeB, SCollision& collision);
+bool	CollidePolygonCircle(const CPolygon& poly, const CPolygon& circle, SCollision& collision);
+bool	CollidePolygonCapsule(const CPolygon& poly, const CPolygon& capsule, SCollision& collision);
+
+#endif
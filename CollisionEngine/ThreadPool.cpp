@@ -0,0 +1,110 @@
+#include "ThreadPool.h"
+
+CThreadPool::CThreadPool(size_t workerCount)
+	: m_nextTask(0), m_busy(false)
+{
+	if (workerCount == 0)
+	{
+		const size_t hardwareThreads = std::thread::hardware_concurrency();
+		workerCount = (hardwareThreads > 1) ? hardwareThreads - 1 : 0;
+	}
+
+	for (size_t index = 0; index < workerCount; ++index)
+	{
+		m_workers.emplace_back(&CThreadPool::WorkerLoop, this);
+	}
+}
+
+CThreadPool::~CThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_wakeUp.notify_all();
+
+	for (std::thread& worker : m_workers)
+	{
+		worker.join();
+	}
+}
+
+size_t CThreadPool::GetThreadCount() const
+{
+	return m_workers.size() + 1;
+}
+
+void CThreadPool::ParallelFor(size_t taskCount, const std::function<void(size_t)>& task)
+{
+	if (taskCount == 0) return;
+
+	if (m_workers.empty() || taskCount == 1 || m_busy.exchange(true))
+	{
+		for (size_t index = 0; index < taskCount; ++index)
+			task(index);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_task = &task;
+		m_taskCount = taskCount;
+		m_nextTask = 0;
+		++m_generation;
+	}
+	m_wakeUp.notify_all();
+
+	RunTasks(task, taskCount);
+
+	/** Every task index is claimed once the caller is out of RunTasks, they are all done when no worker is still running **/
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_done.wait(lock, [this]() { return m_activeWorkers == 0; });
+		m_task = nullptr;
+	}
+
+	m_busy = false;
+}
+
+void CThreadPool::WorkerLoop()
+{
+	uint64_t lastGeneration = 0;
+
+	for (;;)
+	{
+		const std::function<void(size_t)>* task;
+		size_t taskCount;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_wakeUp.wait(lock, [&]() { return m_stop || m_generation != lastGeneration; });
+			if (m_stop) return;
+
+			lastGeneration = m_generation;
+			/** Woken too late, the job is already over **/
+			if (!m_task) continue;
+
+			task = m_task;
+			taskCount = m_taskCount;
+			++m_activeWorkers;
+		}
+
+		RunTasks(*task, taskCount);
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			--m_activeWorkers;
+		}
+		m_done.notify_one();
+	}
+}
+
+void CThreadPool::RunTasks(const std::function<void(size_t)>& task, size_t taskCount)
+{
+	for (;;)
+	{
+		const size_t index = m_nextTask.fetch_add(1);
+		if (index >= taskCount) return;
+
+		task(index);
+	}
+}
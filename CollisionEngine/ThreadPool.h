@@ -0,0 +1,45 @@
+#ifndef _THREAD_POOL_H_
+#define _THREAD_POOL_H_
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+
+class CThreadPool
+{
+public:
+	/** 0 worker count uses one worker per hardware thread minus the calling one **/
+	CThreadPool(size_t workerCount = 0);
+	~CThreadPool();
+
+	/** Workers + calling thread **/
+	size_t	GetThreadCount() const;
+
+	/** Runs task(0) .. task(taskCount - 1) on the workers and the calling thread, returns once all are done.
+	Tasks are picked in any order, write results to per task storage to keep the output deterministic.
+	Nested calls run serially on the calling thread. **/
+	void	ParallelFor(size_t taskCount, const std::function<void(size_t)>& task);
+
+private:
+	void	WorkerLoop();
+	void	RunTasks(const std::function<void(size_t)>& task, size_t taskCount);
+
+	std::vector<std::thread>				m_workers;
+	std::mutex								m_mutex;
+	std::condition_variable					m_wakeUp;
+	std::condition_variable					m_done;
+
+	/** Current job, only changed under the mutex while no worker is active **/
+	const std::function<void(size_t)>*		m_task = nullptr;
+	size_t									m_taskCount = 0;
+	uint64_t								m_generation = 0;
+	size_t									m_activeWorkers = 0;
+	std::atomic<size_t>						m_nextTask;
+	std::atomic<bool>						m_busy;
+	bool									m_stop = false;
+};
+
+#endif
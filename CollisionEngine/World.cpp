@@ -46,6 +46,29 @@ CPolygonPtr		CWorld::AddSymetricPolygon(float radius, size_t sides)
 	return poly;
 }
 
+CPolygonPtr		CWorld::AddCircle(float radius)
+{
+	CPolygonPtr poly = AddPolygon();
+	poly->shapeType = ShapeType::Circle;
+	poly->radius = radius;
+	poly->points.push_back({ 0.0f, 0.0f });
+	poly->Build();
+
+	return poly;
+}
+
+CPolygonPtr		CWorld::AddCapsule(float length, float radius)
+{
+	CPolygonPtr poly = AddPolygon();
+	poly->shapeType = ShapeType::Capsule;
+	poly->radius = radius;
+	poly->points.push_back({ -length * 0.5f, 0.0f });
+	poly->points.push_back({ length * 0.5f, 0.0f });
+	poly->Build();
+
+	return poly;
+}
+
 CPolygonPtr		CWorld::AddRandomPoly(const SRandomPolyParams& params)
 {
 	size_t pointsCount = (size_t)Random(params.minPoints, params.maxPoints);
@@ -128,10 +151,10 @@ void	CWorld::Update(float frameTime)
 	}
 }
 
-void	CWorld::RenderPolygons()
+void	CWorld::RenderPolygons(float interpolation)
 {
 	for (CPolygonPtr polygon : m_polygons)
 	{
-		polygon->Draw();
+		polygon->Draw(interpolation);
 	}
 }
\ No newline at end of file
@@ -22,6 +22,9 @@ public:
 	CPolygonPtr		AddSquare(float size);
 	CPolygonPtr		AddSymetricPolygon(float radius, size_t sides);
 	CPolygonPtr		AddRandomPoly(const SRandomPolyParams& params);
+	CPolygonPtr		AddCircle(float radius);
+	// length between the centers of the two caps, along local x
+	CPolygonPtr		AddCapsule(float length, float radius);
 
 	CPolygonPtr		AddPolygon();
 	void			RemovePolygon(CPolygonPtr poly);
@@ -59,7 +62,7 @@ public:
 	}
 
 	void Update(float frameTime);
-	void RenderPolygons();
+	void RenderPolygons(float interpolation = 1.0f);
 
 protected:
 	std::vector<CPolygonPtr>	m_polygons;
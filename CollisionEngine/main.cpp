@@ -22,6 +22,7 @@
 #include "Scenes/SceneSpheres.h"
 #include "Scenes/SceneComplexPhysic.h"
 #include "Scenes/SceneSmallPhysic.h"
+#include "Scenes/SceneNarrowPhaseBenchmark.h"
 
 
 /*
@@ -37,6 +38,7 @@ int _tmain(int argc, char** argv)
 	gVars->pSceneManager->AddScene(new CSceneSimplePhysic());
 	gVars->pSceneManager->AddScene(new CSceneComplexPhysic(25));
 	gVars->pSceneManager->AddScene(new CSceneDebugCollisions);
+	gVars->pSceneManager->AddScene(new CSceneNarrowPhaseBenchmark(3000));
 
 
 